@@ -0,0 +1 @@
+g++ -std=c++14 -O2 -pthread -I./include bench/texture_formats.cpp src/Color.cpp src/FloydSteinberg.cpp src/Image.cpp src/ImageDecodePool.cpp src/ImageData.cpp src/ImageDataView.cpp src/MappedFile.cpp src/OrderedDither.cpp src/PixelBuffer.cpp src/PackedImageData.cpp src/dxt.cpp src/rg_etc1.cpp -o ./texture_formats
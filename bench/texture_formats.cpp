@@ -0,0 +1,173 @@
+// Texture format benchmark: packs a fixed corpus of images into every
+// PackedImageData format and reports throughput, size and quality.
+//
+// Usage: texture_formats [image files...]
+// Without arguments only the built-in synthetic corpus is used.
+
+#include <Image.h>
+#include <ImageData.h>
+#include <PackedImageData.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace canvas;
+
+class FileImage : public Image {
+public:
+  FileImage(const std::string & filename) : Image(filename, 1.0f) { }
+
+protected:
+  void loadFile() override {
+    data = loadFromFile(getFilename());
+  }
+};
+
+// the higher ETC1 qualities take seconds per megapixel
+#define MEDIUM_ETC1_SIZE 1024
+#define HIGH_ETC1_SIZE 256
+
+struct Sample {
+  std::string name;
+  std::unique_ptr<ImageData> image;
+};
+
+struct Encoder {
+  const char * name;
+  InternalFormat format;
+  Dithering dithering;
+  unsigned short quality;
+  // larger images are skipped for slow encoders, 0 for no limit
+  unsigned int max_size;
+};
+
+// deterministic pseudo random numbers so that runs are comparable
+static unsigned int next_random(unsigned int & state) {
+  state = state * 1664525 + 1013904223;
+  return state >> 8;
+}
+
+static std::unique_ptr<ImageData> createGradient(unsigned int w, unsigned int h) {
+  std::unique_ptr<ImageData> img(new ImageData(w, h, 4));
+  unsigned char * p = img->getData();
+  for (unsigned int y = 0; y < h; y++) {
+    for (unsigned int x = 0; x < w; x++, p += 4) {
+      p[0] = x * 255 / (w - 1);
+      p[1] = y * 255 / (h - 1);
+      p[2] = (x + y) * 255 / (w + h - 2);
+      p[3] = 255 - p[0] / 2;
+    }
+  }
+  return img;
+}
+
+// smooth value noise, resembles photographic content
+static std::unique_ptr<ImageData> createNoise(unsigned int w, unsigned int h) {
+  const unsigned int grid = 17;
+  unsigned int state = 12345;
+  vector<unsigned char> lattice(grid * grid * 3);
+  for (auto & v : lattice) v = next_random(state) & 0xff;
+  std::unique_ptr<ImageData> img(new ImageData(w, h, 4));
+  unsigned char * p = img->getData();
+  for (unsigned int y = 0; y < h; y++) {
+    for (unsigned int x = 0; x < w; x++, p += 4) {
+      float fx = float(x) * (grid - 1) / w, fy = float(y) * (grid - 1) / h;
+      unsigned int ix = (unsigned int)fx, iy = (unsigned int)fy;
+      float tx = fx - ix, ty = fy - iy;
+      for (unsigned int c = 0; c < 3; c++) {
+	float v00 = lattice[(iy * grid + ix) * 3 + c], v10 = lattice[(iy * grid + ix + 1) * 3 + c];
+	float v01 = lattice[((iy + 1) * grid + ix) * 3 + c], v11 = lattice[((iy + 1) * grid + ix + 1) * 3 + c];
+	float v = (v00 * (1 - tx) + v10 * tx) * (1 - ty) + (v01 * (1 - tx) + v11 * tx) * ty;
+	p[c] = (unsigned char)(v + (next_random(state) & 7));
+      }
+      p[3] = 255;
+    }
+  }
+  return img;
+}
+
+// hard edged shapes, resembles text and UI content
+static std::unique_ptr<ImageData> createShapes(unsigned int w, unsigned int h) {
+  std::unique_ptr<ImageData> img(new ImageData(w, h, 4));
+  unsigned char * p = img->getData();
+  for (unsigned int y = 0; y < h; y++) {
+    for (unsigned int x = 0; x < w; x++, p += 4) {
+      bool stripe = ((x / 3) % 5) == 0 || ((y / 7) % 11) == 0;
+      bool circle = (x - w / 2.0) * (x - w / 2.0) + (y - h / 2.0) * (y - h / 2.0) < w * h / 9.0;
+      p[0] = stripe ? 20 : 240;
+      p[1] = circle ? 40 : (stripe ? 20 : 230);
+      p[2] = circle ? 200 : (stripe ? 20 : 220);
+      p[3] = circle || stripe ? 255 : 0;
+    }
+  }
+  return img;
+}
+
+int main(int argc, char ** argv) {
+  const unsigned int sizes[] = { 256, 1024, 2048 };
+  const unsigned int repeats = 3;
+  
+  vector<Sample> corpus;
+  for (auto size : sizes) {
+    corpus.push_back({ "gradient-" + to_string(size), createGradient(size, size) });
+    corpus.push_back({ "noise-" + to_string(size), createNoise(size, size) });
+    corpus.push_back({ "shapes-" + to_string(size), createShapes(size, size) });
+  }
+  for (int i = 1; i < argc; i++) {
+    FileImage img(argv[i]);
+    const ImageData & data = img.getData();
+    if (data.isValid()) {
+      corpus.push_back({ argv[i], std::unique_ptr<ImageData>(new ImageData(data)) });
+    } else {
+      fprintf(stderr, "failed to load %s\n", argv[i]);
+    }
+  }
+
+  const Encoder encoders[] = {
+    { "RGBA4/fs", RGBA4, FLOYD_STEINBERG, 0, 0 },
+    { "RGBA4/ordered", RGBA4, ORDERED_DITHER, 0, 0 },
+    { "RGB565/fs", RGB565, FLOYD_STEINBERG, 0, 0 },
+    { "RGB565/ordered", RGB565, ORDERED_DITHER, 0, 0 },
+    { "RGBA5551/fs", RGBA5551, FLOYD_STEINBERG, 0, 0 },
+    { "LA44", LA44, FLOYD_STEINBERG, 0, 0 },
+    { "ETC1/low", RGB_ETC1, FLOYD_STEINBERG, 0, 0 },
+    { "ETC1/medium", RGB_ETC1, FLOYD_STEINBERG, 1, MEDIUM_ETC1_SIZE },
+    { "ETC1/high", RGB_ETC1, FLOYD_STEINBERG, 2, HIGH_ETC1_SIZE },
+    { "DXT1", RGB_DXT1, FLOYD_STEINBERG, 0, 0 },
+    { "DXT1/hq", RGB_DXT1, FLOYD_STEINBERG, 1, 0 },
+    { "DXT5", RGBA_DXT5, FLOYD_STEINBERG, 0, 0 },
+    { "RGTC1", RED_RGTC1, FLOYD_STEINBERG, 0, 0 },
+    { "RGTC2", RG_RGTC2, FLOYD_STEINBERG, 0, 0 }
+  };
+
+  // PSNR is reported over RGBA and over RGB only, since formats without
+  // alpha would otherwise be scored by the alpha they drop
+  printf("%-16s %-24s %10s %12s %8s %8s %8s\n", "format", "image", "MPixel/s", "bytes", "PSNR", "RGB PSNR", "SSIM");
+  for (auto & e : encoders) {
+    for (auto & s : corpus) {
+      const ImageData & input = *s.image;
+      if (e.max_size && (input.getWidth() > e.max_size || input.getHeight() > e.max_size)) continue;
+      double best = 0, total = 0;
+      std::unique_ptr<PackedImageData> packed;
+      // slow encoders are only run once
+      for (unsigned int i = 0; i < repeats && total < 1.0; i++) {
+	auto t0 = chrono::steady_clock::now();
+	packed = std::unique_ptr<PackedImageData>(new PackedImageData(e.format, 1, input, e.dithering, e.quality));
+	auto t1 = chrono::steady_clock::now();
+	double seconds = chrono::duration<double>(t1 - t0).count();
+	double mps = input.getWidth() * input.getHeight() / seconds / 1000000.0;
+	if (mps > best) best = mps;
+	total += seconds;
+      }
+      auto output = packed->unpack();
+      printf("%-16s %-24s %10.2f %12zu %8.2f %8.2f %8.4f\n", e.name, s.name.c_str(), best, packed->calculateSize(), output->calculatePSNR(input), output->calculatePSNR(input, false), output->calculateSSIM(input));
+      fflush(stdout);
+    }
+  }
+
+  return 0;
+}
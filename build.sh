@@ -1 +1 @@
-g++ -std=c++14 -I./include src/*.cpp -shared -o ./libcanvas.so
+g++ -std=c++14 -pthread -I./include src/*.cpp -shared -o ./libcanvas.so
@@ -7,16 +7,28 @@
 #include <Surface.h>
 #include <Image.h>
 #include <HitRegion.h>
+#include <HitRegionIndex.h>
+#include <HitRegionBuffer.h>
+#include <CoverageMaskCache.h>
+#include <ImageDecodePool.h>
+#include <FilenameConverter.h>
+#include <LRUCache.h>
 
+#include <algorithm>
+#include <future>
 #include <string>
+#include <map>
 #include <memory>
+#include <mutex>
 
 namespace canvas {
   class Context : public GraphicsState {
   public:
     Context(float _display_scale = 1.0f)
       : display_scale(_display_scale),
-      current_linear_gradient(this)
+      current_linear_gradient(this),
+      hit_region_buffer_enabled(false),
+      path_simplification_enabled(false)
       { }
     Context(const Context & other) = delete;
     Context & operator=(const Context & other) = delete;
@@ -37,6 +49,8 @@ namespace canvas {
     virtual void resize(unsigned int _width, unsigned int _height) {
       getDefaultSurface().resize(_width, _height, (unsigned int)(_width * getDisplayScale()), (unsigned int)(_height * getDisplayScale()), getDefaultSurface().getNumChannels());
       hit_regions.clear();
+      hit_region_index.clear();
+      hit_region_buffer.clear();
     }
         
     Context & stroke() { return renderPath(STROKE, currentPath, strokeStyle); }
@@ -55,7 +69,9 @@ namespace canvas {
       return *this;
     }
     
-    bool isPointInPath(const Path2D & path, double x, double y) { return false; }
+    // Points are in canvas space, like the stored path coordinates
+    bool isPointInPath(double x, double y, FillRule rule = NONZERO) const { return currentPath.isInside(x, y, rule); }
+    bool isPointInPath(const Path2D & path, double x, double y, FillRule rule = NONZERO) const { return path.isInside(x, y, rule); }
     
     TextMetrics measureText(const std::string & text) {
       return getDefaultSurface().measureText(font, text, textBaseline.get(), getDisplayScale());
@@ -99,28 +115,18 @@ namespace canvas {
       return drawImage(img.getData(), x, y, w, h);
     }
     
+    // Views are passed to the surface as is, without copying the pixels
+    Context & drawImage(const ImageDataView & img, double x, double y, double w, double h) {
+      return drawImageData(img, x, y, w, h);
+    }
+
     virtual Context & drawImage(const ImageData & img, double x, double y, double w, double h) {
-      Point p = currentTransform.multiply(x, y);
-      if (hasNativeShadows()) {
-	getDefaultSurface().drawImage(img, p, w, h, getDisplayScale(), globalAlpha.get(), shadowBlur.get(), shadowOffsetX.get(), shadowOffsetY.get(), shadowColor.get(), clipPath, imageSmoothingEnabled.get());
-      } else {
-	if (hasShadow()) {
-	  float b = shadowBlur.get(), bs = shadowBlur.get() * getDisplayScale();
-	  float bi = int(ceil(b));
-	  auto shadow = createSurface(getDefaultSurface().getLogicalWidth() + 2 * bi, getDefaultSurface().getLogicalHeight() + 2 * bi, R8);
-	  shadow->drawImage(img, Point(x + b + shadowOffsetX.get(), y + b + shadowOffsetY.get()), w, h, getDisplayScale(), globalAlpha.get(), 0.0f, 0.0f, 0.0f, shadowColor.get(), clipPath, imageSmoothingEnabled.get());
-	  // shadow->colorFill(shadowColor.get());
-	  auto shadow1 = shadow->blur(bs, bs);
-	  auto shadow2 = shadow1->colorize(shadowColor.get());
-	  getDefaultSurface().drawImage(*shadow2, Point(-b, -b), shadow->getLogicalWidth(), shadow->getLogicalHeight(), getDisplayScale(), 1.0f, 0.0f, 0.0f, 0.0f, shadowColor.get(), Path2D(), false);
-	}
-	getDefaultSurface().drawImage(img, p, w, h, getDisplayScale(), globalAlpha.get(), 0.0f, 0.0f, 0.0f, shadowColor.get(), clipPath, imageSmoothingEnabled.get());
-      }
-      return *this;
+      return drawImageData(img, x, y, w, h);
     }
     
     virtual Context & drawImage(Surface & img, double x, double y, double w, double h) {
       Point p = currentTransform.multiply(x, y);
+      if (!isVisible(p.x, p.y, p.x + w, p.y + h)) return *this;
       if (hasNativeShadows()) {
 	getDefaultSurface().drawImage(img, p, w, h, getDisplayScale(), globalAlpha.get(), shadowBlur.get(), shadowOffsetX.get(), shadowOffsetY.get(), shadowColor.get(), clipPath, imageSmoothingEnabled.get());
       } else {
@@ -147,22 +153,49 @@ namespace canvas {
     }
 
     float getDisplayScale() const { return display_scale; }
-    Context & addHitRegion(const std::string & id, const std::string & cursor) {
+    Context & addHitRegion(const std::string & id, const std::string & cursor, FillRule rule = NONZERO) {
       if (!currentPath.empty()) {
-	HitRegion hr(id, currentPath, cursor);
-	hit_regions.push_back(hr);
+	double min_x, min_y, max_x, max_y;
+	currentPath.getExtents(min_x, min_y, max_x, max_y);
+	hit_region_index.insert(hit_regions.size(), min_x, min_y, max_x, max_y);
+	hit_regions.push_back(HitRegion(id, currentPath, cursor, rule));
+	if (hit_region_buffer_enabled) {
+	  hit_region_buffer.addRegion(getWidth(), getHeight(), (unsigned int)hit_regions.size(), currentPath, rule);
+	}
       }
       return *this;
     }
-#if 0
-    const HitRegion & getHitRegion(float x, float y) const {
-      for (auto & r : hit_regions) {
-	if (r.isInside(x, y)) return r;
+    // Returns the topmost (last added) region containing the point
+    const HitRegion & getHitRegion(double x, double y) const {
+      if (hit_region_buffer.isAllocated() && hit_region_buffer.contains(x, y)) {
+	unsigned int id = hit_region_buffer.getId(x, y);
+	return id ? hit_regions[id - 1] : null_region;
       }
-      return null_region;
+      long long i = hit_region_index.findTopmost(x, y, [&](size_t i) { return hit_regions[i].isInside(x, y); });
+      return i >= 0 ? hit_regions[i] : null_region;
     }
-#endif
     const std::vector<HitRegion> & getHitRegions() const { return hit_regions; }
+
+    // Simplifies long polyline paths to a quarter device pixel and clips
+    // them to the visible area before they reach the backend
+    void setPathSimplificationEnabled(bool t) { path_simplification_enabled = t; }
+    static const size_t min_simplified_path_size = 256;
+
+    // Small solid fills are rasterized once into the cache and drawn as
+    // masks afterwards. The cache may be shared between contexts.
+    void setCoverageMaskCache(std::shared_ptr<CoverageMaskCache> cache) { coverage_mask_cache = cache; }
+    const std::shared_ptr<CoverageMaskCache> & getCoverageMaskCache() const { return coverage_mask_cache; }
+    // Rasterizes hit regions into a per-pixel id buffer as they are added,
+    // making on-surface lookups a single read
+    void setHitRegionBufferEnabled(bool t) {
+      hit_region_buffer_enabled = t;
+      hit_region_buffer.clear();
+      if (t) {
+	for (size_t i = 0; i < hit_regions.size(); i++) {
+	  hit_region_buffer.addRegion(getWidth(), getHeight(), (unsigned int)(i + 1), hit_regions[i].getPath(), hit_regions[i].getFillRule());
+	}
+      }
+    }
     
 #if 0
     Style & createPattern(const ImageData & image, const char * repeat) {
@@ -173,7 +206,53 @@ namespace canvas {
 #endif
     
   protected:
+    // Shared by ImageData and ImageDataView so that each reaches the matching Surface overload
+    template <class T> Context & drawImageData(const T & img, double x, double y, double w, double h) {
+      Point p = currentTransform.multiply(x, y);
+      if (!isVisible(p.x, p.y, p.x + w, p.y + h)) return *this;
+      if (hasNativeShadows()) {
+	getDefaultSurface().drawImage(img, p, w, h, getDisplayScale(), globalAlpha.get(), shadowBlur.get(), shadowOffsetX.get(), shadowOffsetY.get(), shadowColor.get(), clipPath, imageSmoothingEnabled.get());
+      } else {
+	if (hasShadow()) {
+	  float b = shadowBlur.get(), bs = shadowBlur.get() * getDisplayScale();
+	  float bi = int(ceil(b));
+	  auto shadow = createSurface(getDefaultSurface().getLogicalWidth() + 2 * bi, getDefaultSurface().getLogicalHeight() + 2 * bi, R8);
+	  shadow->drawImage(img, Point(x + b + shadowOffsetX.get(), y + b + shadowOffsetY.get()), w, h, getDisplayScale(), globalAlpha.get(), 0.0f, 0.0f, 0.0f, shadowColor.get(), clipPath, imageSmoothingEnabled.get());
+	  // shadow->colorFill(shadowColor.get());
+	  auto shadow1 = shadow->blur(bs, bs);
+	  auto shadow2 = shadow1->colorize(shadowColor.get());
+	  getDefaultSurface().drawImage(*shadow2, Point(-b, -b), shadow->getLogicalWidth(), shadow->getLogicalHeight(), getDisplayScale(), 1.0f, 0.0f, 0.0f, 0.0f, shadowColor.get(), Path2D(), false);
+	}
+	getDefaultSurface().drawImage(img, p, w, h, getDisplayScale(), globalAlpha.get(), 0.0f, 0.0f, 0.0f, shadowColor.get(), clipPath, imageSmoothingEnabled.get());
+      }
+      return *this;
+    }
+
     Context & renderPath(RenderMode mode, const Path2D & path, const Style & style, Operator op = SOURCE_OVER) {
+      double min_x, min_y, max_x, max_y;
+      path.getExtents(min_x, min_y, max_x, max_y);
+      // a full line width covers round joins and square caps
+      double margin = mode == STROKE ? lineWidth.get() : 0;
+      if (path.empty() || !isVisible(min_x, min_y, max_x, max_y, margin)) {
+	return *this;
+      }
+      if (path_simplification_enabled && path.size() >= min_simplified_path_size && path.isFlat()) {
+	double x0, y0, x1, y1;
+	getVisibleBounds(x0, y0, x1, y1, margin + 1);
+	return renderVisiblePath(mode, path.simplify(0.25 / getDisplayScale(), x0, y0, x1, y1, mode == FILL, 1.0 / getDisplayScale()), style, op);
+      }
+      if (coverage_mask_cache && mode == FILL && op == SOURCE_OVER && style.getType() == Style::SOLID && !hasShadow() && clipPath.empty()) {
+	int x, y;
+	auto mask = coverage_mask_cache->getMask(path, NONZERO, style.color, getDisplayScale(), x, y);
+	if (mask) {
+	  getDefaultSurface().drawMask(*mask, x, y, getDisplayScale(), globalAlpha.get());
+	  return *this;
+	}
+      }
+      return renderVisiblePath(mode, path, style, op);
+    }
+
+    Context & renderVisiblePath(RenderMode mode, const Path2D & path, const Style & style, Operator op) {
       if (hasNativeShadows()) {
 	getDefaultSurface().renderPath(mode, path, style, lineWidth.get(), op, getDisplayScale(), globalAlpha.get(), shadowBlur.get(), shadowOffsetX.get(), shadowOffsetY.get(), shadowColor.get(), clipPath);
       } else {
@@ -220,18 +299,79 @@ namespace canvas {
     }
 
     bool hasShadow() const { return shadowBlur.get() > 0.0f || shadowOffsetX.get() != 0 || shadowOffsetY.get() != 0; }
+
+    // Canvas space box outside of which geometry can't affect the surface,
+    // including the area from which the shadow is cast
+    void getVisibleBounds(double & min_x, double & min_y, double & max_x, double & max_y, double margin = 0) const {
+      min_x = min_y = 0;
+      max_x = getWidth();
+      max_y = getHeight();
+      if (hasShadow()) {
+	double b = 2 * shadowBlur.get(), dx = shadowOffsetX.get(), dy = shadowOffsetY.get();
+	min_x = std::min(min_x, -dx - b);
+	min_y = std::min(min_y, -dy - b);
+	max_x = std::max(max_x, max_x - dx + b);
+	max_y = std::max(max_y, max_y - dy + b);
+      }
+      if (!clipPath.empty()) {
+	double cx0, cy0, cx1, cy1;
+	clipPath.getExtents(cx0, cy0, cx1, cy1);
+	min_x = std::max(min_x, cx0);
+	min_y = std::max(min_y, cy0);
+	max_x = std::min(max_x, cx1);
+	max_y = std::min(max_y, cy1);
+      }
+      min_x -= margin;
+      min_y -= margin;
+      max_x += margin;
+      max_y += margin;
+    }
+
+    // Returns false if a draw covering the given canvas space box (grown
+    // by margin), and its shadow, can't touch the surface or clip region
+    bool isVisible(double min_x, double min_y, double max_x, double max_y, double margin = 0) const {
+      if (min_x > max_x) std::swap(min_x, max_x);
+      if (min_y > max_y) std::swap(min_y, max_y);
+      // one extra unit for antialiasing
+      margin += 1;
+      min_x -= margin;
+      min_y -= margin;
+      max_x += margin;
+      max_y += margin;
+      double w = getWidth(), h = getHeight();
+      double cx0 = 0, cy0 = 0, cx1 = w, cy1 = h;
+      if (!clipPath.empty()) clipPath.getExtents(cx0, cy0, cx1, cy1);
+      if (max_x > std::max(0.0, cx0) && min_x < std::min(w, cx1) &&
+	  max_y > std::max(0.0, cy0) && min_y < std::min(h, cy1)) {
+	return true;
+      }
+      if (hasShadow()) {
+	// the shadow is clipped before it is offset
+	double b = 2 * shadowBlur.get(), dx = shadowOffsetX.get(), dy = shadowOffsetY.get();
+	return max_x + b > cx0 && min_x - b < cx1 && max_y + b > cy0 && min_y - b < cy1 &&
+	  max_x + dx + b > 0 && min_x + dx - b < w && max_y + dy + b > 0 && min_y + dy - b < h;
+      }
+      return false;
+    }
     
   private:
     float display_scale;
     Style current_linear_gradient;
     std::vector<GraphicsState> restore_stack;
     std::vector<HitRegion> hit_regions;
+    HitRegionIndex hit_region_index;
+    HitRegionBuffer hit_region_buffer;
+    bool hit_region_buffer_enabled;
+    bool path_simplification_enabled;
+    std::shared_ptr<CoverageMaskCache> coverage_mask_cache;
     HitRegion null_region;
   };
     
+  typedef LRUCache<std::string, ImageData> ImageCache;
+
   class ContextFactory {
   public:
-    ContextFactory(float _display_scale) : display_scale(_display_scale) { }
+    ContextFactory(float _display_scale) : display_scale(_display_scale), image_cache(64 * 1024 * 1024) { }
     virtual ~ContextFactory() { }
     virtual std::unique_ptr<Context> createContext(unsigned int width, unsigned int height, unsigned int num_channels = 4) = 0;
     virtual std::unique_ptr<Surface> createSurface(unsigned int width, unsigned int height, unsigned int num_channels = 4) = 0;
@@ -239,10 +379,94 @@ namespace canvas {
     virtual std::unique_ptr<Image> createImage() = 0;
     virtual std::unique_ptr<Image> createImage(const unsigned char * _data, unsigned int _width, unsigned int _height, unsigned int _num_channels) = 0;
     
+    // Returns an image whose decode has been queued on the factory's decode
+    // pool; higher priority images are decoded first.
+    std::shared_ptr<Image> loadImageAsync(const std::string & filename, int priority = 0, std::function<void(const std::shared_ptr<ImageData> &)> callback = nullptr) {
+      std::shared_ptr<Image> image(loadImage(filename));
+      Image::loadAsync(image, getDecodePool(), priority, callback);
+      return image;
+    }
+
+    // Loads an image through the shared cache. Decoded data is keyed by the
+    // converted filename and the target size (0 x 0 for the original size),
+    // so that repeated references share one decode. Concurrent loads of a
+    // key that is still being decoded wait for that decode.
+    std::shared_ptr<Image> loadImageCached(const std::string & filename, unsigned int target_width = 0, unsigned int target_height = 0) {
+      std::string resolved = filename;
+      if (filename_converter.get() && !filename_converter->convert(filename, resolved)) {
+	resolved = filename;
+      }
+      std::string key = resolved + "#" + std::to_string(target_width) + "x" + std::to_string(target_height);
+      std::shared_ptr<Image> image(loadImage(resolved));
+
+      std::shared_ptr<ImageData> data;
+      std::shared_future<std::shared_ptr<ImageData> > pending;
+      std::promise<std::shared_ptr<ImageData> > promise;
+      // only the caller that registered the pending entry removes it
+      bool registered = false;
+      {
+	std::lock_guard<std::mutex> guard(pending_images_mutex);
+	data = image_cache.get(key);
+	if (!data.get()) {
+	  auto it = pending_images.find(key);
+	  if (it != pending_images.end()) {
+	    pending = it->second;
+	  } else {
+	    pending_images[key] = promise.get_future().share();
+	    registered = true;
+	  }
+	}
+      }
+      if (!data.get() && pending.valid()) {
+	data = pending.get(); // rethrows decode errors
+      }
+      if (data.get()) {
+	image->setSharedData(std::move(data));
+	return image;
+      }
+
+      try {
+	if (target_width && target_height) image->scale(target_width, target_height);
+	data = image->getSharedData();
+      } catch (...) {
+	if (registered) {
+	  std::lock_guard<std::mutex> guard(pending_images_mutex);
+	  pending_images.erase(key);
+	  promise.set_exception(std::current_exception());
+	}
+	throw;
+      }
+      if (data.get() && data->isValid()) image_cache.put(key, data, data->calculateSize());
+      if (registered) {
+	{
+	  // the data is in the cache before the pending entry goes away
+	  std::lock_guard<std::mutex> guard(pending_images_mutex);
+	  pending_images.erase(key);
+	}
+	promise.set_value(data);
+      }
+      return image;
+    }
+
+    ImageCache & getImageCache() { return image_cache; }
+    void setFilenameConverter(std::shared_ptr<FilenameConverter> _filename_converter) { filename_converter = _filename_converter; }
+
+    ImageDecodePool & getDecodePool() {
+      std::lock_guard<std::mutex> guard(decode_pool_mutex);
+      if (!decode_pool.get()) decode_pool = std::unique_ptr<ImageDecodePool>(new ImageDecodePool);
+      return *decode_pool;
+    }
+
     float getDisplayScale() const { return display_scale; }
     
   private:
     float display_scale;
+    std::unique_ptr<ImageDecodePool> decode_pool;
+    std::mutex decode_pool_mutex;
+    ImageCache image_cache;
+    std::map<std::string, std::shared_future<std::shared_ptr<ImageData> > > pending_images;
+    std::mutex pending_images_mutex;
+    std::shared_ptr<FilenameConverter> filename_converter;
   };
 
   class NullContext : public Context {
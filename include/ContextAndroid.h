@@ -53,6 +53,8 @@ class AndroidCache {
   jmethodID pathLineToMethod;
   jmethodID pathCloseMethod;
   jmethodID pathArcToMethod;
+  jmethodID pathQuadToMethod;
+  jmethodID pathCubicToMethod;
   jmethodID canvasPathDrawMethod;
   jmethodID rectFConstructor;
   jmethodID rectConstructor;
@@ -392,7 +394,8 @@ public:
 
     jobject jpath = env->NewObject(cache->pathClass, cache->pathConstructor);
 
-    for (auto pc : path.getData()) {
+    bool started = false;
+    for (auto pc : path) {
       switch (pc.type) {
       case PathComponent::MOVE_TO: {
         env->CallVoidMethod(jpath, cache->pathMoveToMethod, pc.x0 * displayScale, pc.y0 * displayScale);
@@ -404,34 +407,45 @@ public:
         break;
       case PathComponent::ARC: {
 
-        float span = 0;
-
-#if 0
-        // FIXME: If ea = 0, and sa = 2 * M_PI => span = 0
-        if (!pc.anticlockwise && (pc.ea < pc.sa)) {
-          span += 2 * M_PI;
-        } else if (pc.anticlockwise && (pc.sa < pc.ea)) {
-          span -= 2 * M_PI;
+        float span = PathComponent::getArcSpan(pc.sa, pc.ea, pc.anticlockwise);
+        // a rotated circle only moves its start angle
+        double sa = pc.radius == pc.radius_y ? pc.sa + pc.rotation : pc.sa;
+        if (pc.radius != pc.radius_y && pc.rotation != 0) {
+          // Path.arcTo only takes axis aligned ovals, so flatten rotated ellipses
+          double r = std::max(fabs(pc.radius), fabs(pc.radius_y)) * displayScale;
+          double step = r > 0.25 ? 2 * acos(1 - 0.25 / r) : M_PI / 2;
+          int n = std::max(1, std::min(4096, int(ceil(fabs(span) / step))));
+          for (int i = 0; i <= n; i++) {
+            Point p = pc.getArcPoint(pc.sa + span * i / n);
+            env->CallVoidMethod(jpath, i == 0 && !started ? cache->pathMoveToMethod : cache->pathLineToMethod, float(p.x * displayScale), float(p.y * displayScale));
+          }
+          break;
         }
-#endif
-
-        span += pc.ea - pc.sa;
         float left = pc.x0 * displayScale - pc.radius * displayScale;
         float right = pc.x0 * displayScale + pc.radius * displayScale;
-        float bottom = pc.y0 * displayScale + pc.radius * displayScale;
-        float top = pc.y0 * displayScale - pc.radius * displayScale;
+        float bottom = pc.y0 * displayScale + pc.radius_y * displayScale;
+        float top = pc.y0 * displayScale - pc.radius_y * displayScale;
 
         jobject jrect = env->NewObject(cache->rectFClass, cache->rectFConstructor, left, top, right, bottom);
 
-        env->CallVoidMethod(jpath, cache->pathArcToMethod, jrect, (float) (pc.sa / M_PI * 180), (float) (span / M_PI * 180));
+        env->CallVoidMethod(jpath, cache->pathArcToMethod, jrect, (float) (sa / M_PI * 180), (float) (span / M_PI * 180));
         env->DeleteLocalRef(jrect);
       }
         break;
+      case PathComponent::QUADRATIC_TO: {
+        env->CallVoidMethod(jpath, cache->pathQuadToMethod, pc.cx0 * displayScale, pc.cy0 * displayScale, pc.x0 * displayScale, pc.y0 * displayScale);
+      }
+        break;
+      case PathComponent::CUBIC_TO: {
+        env->CallVoidMethod(jpath, cache->pathCubicToMethod, pc.cx0 * displayScale, pc.cy0 * displayScale, pc.cx1 * displayScale, pc.cy1 * displayScale, pc.x0 * displayScale, pc.y0 * displayScale);
+      }
+        break;
       case PathComponent::CLOSE: {
         env->CallVoidMethod(jpath, cache->pathCloseMethod);
       }
         break;
       }
+      started = true;
     }
 
     // Draw path to canvas
@@ -529,6 +543,8 @@ public:
     return TextMetrics(textWidth / displayScale, descent / displayScale, ascent / displayScale);
   }
 
+  using Surface::drawImage;
+
   void drawImage(Surface & _img, const Point & p, double w, double h, float displayScale, float globalAlpha, float shadowBlur, float shadowOffsetX, float shadowOffsetY, const Color & shadowColor, const Path2D & clipPath, bool imageSmoothingEnabled = true) override {
     __android_log_print(ANDROID_LOG_VERBOSE, "Sometrik", "DrawImage (Surface) called");
     AndroidSurface * native_surface = dynamic_cast<canvas::AndroidSurface *>(&_img);
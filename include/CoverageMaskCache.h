@@ -0,0 +1,51 @@
+#ifndef _CANVAS_COVERAGEMASKCACHE_H_
+#define _CANVAS_COVERAGEMASKCACHE_H_
+
+#include <Color.h>
+#include <ImageData.h>
+#include <LRUCache.h>
+#include <Path2D.h>
+#include <FillRule.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace canvas {
+  // R8 coverage of a filled path, the color filled through it as an RGBA
+  // image for surfaces that draw masks as images, and the quantized key
+  // the entry was built from
+  struct CoverageMask {
+    CoverageMask(unsigned int width, unsigned int height) : mask(width, height, 1, false) { }
+    std::vector<int32_t> key;
+    ImageData mask;
+    std::unique_ptr<ImageData> image;
+  };
+
+  // Coverage masks of filled paths, shared between draws of the same
+  // shape and color at different positions. Masks are keyed by the path
+  // relative to its bounds, the fill rule, the color, the display scale
+  // and the subpixel position of the bounds, quantized to subpixel_steps
+  // per pixel. Entries are found by a hash of the key and then compared
+  // in full.
+  class CoverageMaskCache {
+  public:
+    CoverageMaskCache(size_t budget = 16 * 1024 * 1024, unsigned int _subpixel_steps = 4, unsigned int _max_mask_size = 256)
+      : cache(budget), subpixel_steps(_subpixel_steps), max_mask_size(_max_mask_size) { }
+
+    // Returns the device resolution mask of the path and sets x, y to the
+    // device pixel of its top left corner, or null if the path is too
+    // large to be worth caching
+    std::shared_ptr<const CoverageMask> getMask(const Path2D & path, FillRule rule, const Color & color, float display_scale, int & x, int & y);
+
+    void clear() { cache.clear(); }
+    void setBudget(size_t budget) { cache.setBudget(budget); }
+    LRUCache<uint64_t, CoverageMask>::Statistics getStatistics() const { return cache.getStatistics(); }
+    
+  private:
+    LRUCache<uint64_t, CoverageMask> cache;
+    unsigned int subpixel_steps, max_mask_size;
+  };
+};
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef _DITHERING_H_
+#define _DITHERING_H_
+
+namespace canvas {
+  enum Dithering {
+    FLOYD_STEINBERG = 1, // error diffusion, best quality, single threaded
+    ORDERED_DITHER // Bayer matrix, pixel independent and parallel
+  };
+};
+
+#endif
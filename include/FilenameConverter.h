@@ -1,6 +1,8 @@
 #ifndef _FILENAMECONVERTER_H_
 #define _FILENAMECONVERTER_H_
 
+#include <string>
+
 namespace canvas {
   class FilenameConverter {
   public:
@@ -0,0 +1,11 @@
+#ifndef _CANVAS_FILLRULE_H_
+#define _CANVAS_FILLRULE_H_
+
+namespace canvas {
+  enum FillRule {
+    NONZERO = 1,
+    EVENODD
+  };
+};
+
+#endif
@@ -3,18 +3,21 @@
 
 #include <InternalFormat.h>
 #include <memory>
+#include <vector>
 
 namespace canvas {
-  class ImageData;
+  class ImageDataView;
 
   class FloydSteinberg  {
   public:
     FloydSteinberg(InternalFormat _target_format) : target_format(_target_format) { }
 
-    unsigned int apply(const ImageData & input_image, unsigned char * output) const;
+    size_t apply(const ImageDataView & input_image, unsigned char * output) const;
 
   private:
     InternalFormat target_format;
+    // two rows of per-channel errors, reused between rows and calls
+    mutable std::vector<unsigned short> errors;
   };
 };
 
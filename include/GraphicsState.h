@@ -27,9 +27,25 @@ namespace canvas {
       imageSmoothingEnabled(this, true)
       { }
 
-    GraphicsState & arc(double x, double y, double r, double a0, double a1, bool t = false) { currentPath.arc(currentTransform.multiply(x, y), r, currentTransform.transformAngle(a0), currentTransform.transformAngle(a1), t); return *this; }
+    GraphicsState & arc(double x, double y, double r, double a0, double a1, bool t = false) {
+      double sa = currentTransform.transformAngle(a0), ea = currentTransform.transformAngle(a1);
+      // a rotated full circle must not collapse when both angles map to the same value
+      if (fabs(a1 - a0) >= 2 * M_PI) ea = sa + (a1 > a0 ? 2 * M_PI : -2 * M_PI);
+      currentPath.arc(currentTransform.multiply(x, y), r, sa, ea, t);
+      return *this;
+    }
+    // The angles are relative to the ellipse axes, so the transform only
+    // rotates the ellipse itself
+    GraphicsState & ellipse(double x, double y, double rx, double ry, double rotation, double a0, double a1, bool t = false) {
+      currentPath.ellipse(currentTransform.multiply(x, y), rx, ry, currentTransform.transformAngle(rotation), a0, a1, t);
+      return *this;
+    }
     GraphicsState & moveTo(double x, double y) { currentPath.moveTo(currentTransform.multiply(x, y)); return *this; }
     GraphicsState & lineTo(double x, double y) { currentPath.lineTo(currentTransform.multiply(x, y)); return *this; }
+    // Appends count interleaved x, y pairs as line segments
+    GraphicsState & lineTo(const float * xy, size_t count) { currentPath.lineTo(xy, count, currentTransform); return *this; }
+    GraphicsState & quadraticCurveTo(double cpx, double cpy, double x, double y) { currentPath.quadraticCurveTo(currentTransform.multiply(cpx, cpy), currentTransform.multiply(x, y)); return *this; }
+    GraphicsState & bezierCurveTo(double cp1x, double cp1y, double cp2x, double cp2y, double x, double y) { currentPath.bezierCurveTo(currentTransform.multiply(cp1x, cp1y), currentTransform.multiply(cp2x, cp2y), currentTransform.multiply(x, y)); return *this; }
     GraphicsState & arcTo(double x1, double y1, double x2, double y2, double radius) { currentPath.arcTo(currentTransform.multiply(x1, y1), currentTransform.multiply(x2, y2), radius); return *this; }
 
     GraphicsState & clip() {
@@ -48,6 +64,7 @@ namespace canvas {
       closePath();
       return *this;
     }
+    GraphicsState & roundRect(double x, double y, double w, double h, double r) { currentPath.roundRect(Point(x, y), w, h, r, currentTransform); return *this; }
 
     GraphicsState & scale(double x, double y) { return transform(Matrix(x, 0.0, 0.0, y, 0.0, 0.0)); }
     GraphicsState & rotate(double angle) {
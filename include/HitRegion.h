@@ -7,18 +7,25 @@
 namespace canvas {
   class HitRegion {
   public:
-    HitRegion() { }
-    HitRegion(const std::string & _id, const Path2D & _path, const std::string & _cursor)
-      : id(_id), cursor(_cursor), path(_path) { }
+    HitRegion() : fill_rule(NONZERO) { }
+    HitRegion(const std::string & _id, const Path2D & _path, const std::string & _cursor, FillRule _fill_rule = NONZERO)
+      : id(_id), cursor(_cursor), path(_path), fill_rule(_fill_rule) {
+      // flatten once so that queries only walk line segments
+      if (!path.isFlat()) flattened_path = path.flatten(0.1);
+    }
 
     const std::string & getId() const { return id; }
     const std::string & getCursor() const { return cursor; }
     const Path2D & getPath() const { return path; }
-//    bool isInside(float x, float y) const { return path.isInside(x, y); }
+    FillRule getFillRule() const { return fill_rule; }
+    bool isInside(double x, double y) const {
+      return (flattened_path.empty() ? path : flattened_path).isInside(x, y, fill_rule);
+    }
     
   private:
     std::string id, cursor;
-    Path2D path;
+    Path2D path, flattened_path;
+    FillRule fill_rule;
   };
 };
 #endif
@@ -0,0 +1,42 @@
+#ifndef _CANVAS_HITREGIONBUFFER_H_
+#define _CANVAS_HITREGIONBUFFER_H_
+
+#include <PixelBuffer.h>
+#include <Path2D.h>
+#include <FillRule.h>
+
+#include <cmath>
+
+namespace canvas {
+  // One 32-bit region id per logical pixel, rasterized with the same
+  // pixel center coverage as the fill. Regions added later overwrite
+  // earlier ones, so each pixel holds the topmost region. Storage is
+  // allocated by the first region added.
+  class HitRegionBuffer {
+  public:
+    HitRegionBuffer() : width(0), height(0) { }
+
+    // Region ids start from 1; 0 marks pixels without a region
+    void addRegion(unsigned int _width, unsigned int _height, unsigned int id, const Path2D & path, FillRule rule);
+    void clear() {
+      buffer.reset();
+      width = height = 0;
+    }
+
+    bool isAllocated() const { return buffer.get() != nullptr; }
+    bool contains(double x, double y) const { return x >= 0 && y >= 0 && x < width && y < height; }
+    unsigned int getId(double x, double y) const {
+      if (!isAllocated() || !contains(x, y)) return 0;
+      return getIds()[size_t(floor(y)) * width + size_t(floor(x))];
+    }
+
+  private:
+    const unsigned int * getIds() const { return reinterpret_cast<const unsigned int *>(buffer.get()); }
+    unsigned int * getIds() { return reinterpret_cast<unsigned int *>(buffer.get()); }
+
+    PixelBuffer buffer;
+    unsigned int width, height;
+  };
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef _CANVAS_HITREGIONINDEX_H_
+#define _CANVAS_HITREGIONINDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace canvas {
+  // Uniform grid over canvas space mapping each cell to the regions whose
+  // bounds overlap it. Regions spanning too many cells are kept in a
+  // separate list that every query checks.
+  class HitRegionIndex {
+  public:
+    HitRegionIndex(double _cell_size = 64.0, size_t _max_cells_per_region = 256)
+      : cell_size(_cell_size), max_cells_per_region(_max_cells_per_region) { }
+
+    void insert(size_t index, double min_x, double min_y, double max_x, double max_y);
+    void clear() {
+      cells.clear();
+      large_regions.clear();
+    }
+
+    // Returns the most recently inserted region that is_inside accepts
+    // at (x, y), or -1 if there is none
+    template<class F>
+    long long findTopmost(double x, double y, F is_inside) const {
+      long long r = -1;
+      auto it = cells.find(getKey(getCell(x), getCell(y)));
+      if (it != cells.end()) {
+	for (auto i = it->second.rbegin(); i != it->second.rend(); ++i) {
+	  if (is_inside(*i)) {
+	    r = (long long)*i;
+	    break;
+	  }
+	}
+      }
+      for (auto i = large_regions.rbegin(); i != large_regions.rend() && (long long)*i > r; ++i) {
+	if (is_inside(*i)) {
+	  r = (long long)*i;
+	  break;
+	}
+      }
+      return r;
+    }
+
+  private:
+    int getCell(double v) const;
+    static uint64_t getKey(int cx, int cy) { return (uint64_t(uint32_t(cx)) << 32) | uint32_t(cy); }
+
+    double cell_size;
+    size_t max_cells_per_region;
+    std::unordered_map<uint64_t, std::vector<size_t> > cells;
+    std::vector<size_t> large_regions;
+  };
+};
+
+#endif
@@ -2,11 +2,17 @@
 #define _IMAGE_H_
 
 #include <ImageData.h>
+#include <ImageDataView.h>
 #include <PackedImageData.h>
 
+#include <functional>
+#include <future>
+#include <memory>
 #include <string>
 
 namespace canvas {
+  class ImageDecodePool;
+
   class Image {
   public:
     Image(float _display_scale) : display_scale(_display_scale) { }
@@ -22,17 +28,21 @@ namespace canvas {
 
     void decode(const unsigned char * buffer, size_t size);
     void scale(unsigned int target_width, unsigned int target_height) {
+      waitForLoad();
       if (!filename.empty() && !data.get()) {
 	loadFile();
       }
       if (data.get()) {
 	unsigned int width = (unsigned int)(target_width * display_scale);
 	unsigned int height = (unsigned int)(target_height * display_scale);
+	// data shared with the image cache or other images must not be modified
+	if (data.use_count() == 1) data->reduce(width, height);
 	data = data->scale(width, height);
       }
     }
 
     const ImageData & getData() {
+      waitForLoad();
       if (!filename.empty() && !data.get()) {
 	loadFile();
       }
@@ -43,15 +53,61 @@ namespace canvas {
       }
     }
 
+    // Reads the dimensions from the file header without decoding. Returns
+    // false if the header could not be parsed.
+    bool probe() {
+      if (isLoaded() && data.get()) {
+	probed_width = data->getWidth();
+	probed_height = data->getHeight();
+	probed_num_channels = data->getNumChannels();
+	return true;
+      }
+      return probed_width || (!filename.empty() && probeFile());
+    }
+
+    // Dimensions of the decoded data, or of the header if only probed
+    unsigned int getWidth() const { return isLoaded() && data.get() ? data->getWidth() : probed_width; }
+    unsigned int getHeight() const { return isLoaded() && data.get() ? data->getHeight() : probed_height; }
+    unsigned int getNumChannels() const { return isLoaded() && data.get() ? data->getNumChannels() : probed_num_channels; }
+
+    // Shares decoded data between images, e.g. through ImageCache
+    std::shared_ptr<ImageData> getSharedData() {
+      getData();
+      return data;
+    }
+    void setSharedData(std::shared_ptr<ImageData> _data) {
+      waitForLoad();
+      data = std::move(_data);
+    }
+
     std::string getFilename() const { return filename; }
 
     void setDisplayScale(float f) { display_scale = f; }
     float getDisplayScale() const { return display_scale; }
 
-    std::unique_ptr<PackedImageData> pack(InternalFormat format, int num_levels) const {
-      return std::unique_ptr<PackedImageData>(new PackedImageData(format, num_levels, *data));
+    std::unique_ptr<PackedImageData> pack(InternalFormat format, int num_levels, Dithering dithering = FLOYD_STEINBERG) {
+      waitForLoad();
+      return std::unique_ptr<PackedImageData>(new PackedImageData(format, num_levels, *data, dithering));
     }
     
+    // Queues the decode of image on pool. getData(), scale() and pack() wait
+    // for it to finish. Callback is invoked on the worker thread with the
+    // decoded data; it must not call methods of the image itself, which
+    // belongs to the thread that owns it. If every owner releases the image
+    // before a worker picks it up, the decode is skipped.
+    static void loadAsync(const std::shared_ptr<Image> & image, ImageDecodePool & pool, int priority = 0, std::function<void(const std::shared_ptr<ImageData> &)> callback = nullptr);
+
+    bool isLoaded() const {
+      return !pending_load.valid() || pending_load.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+    void waitForLoad() {
+      if (pending_load.valid()) {
+	std::shared_future<void> f = pending_load;
+	pending_load = std::shared_future<void>();
+	f.get(); // rethrows decode errors
+      }
+    }
+
     static bool isPNG(const unsigned char * buffer, size_t size);
     static bool isJPEG(const unsigned char * buffer, size_t size);
     static bool isGIF(const unsigned char * buffer, size_t size);
@@ -61,12 +117,16 @@ namespace canvas {
   protected:
     static std::unique_ptr<ImageData> loadFromMemory(const unsigned char * buffer, size_t size);
     static std::unique_ptr<ImageData> loadFromFile(const std::string & filename);
+    static bool probeMemory(const unsigned char * buffer, size_t size, unsigned int & width, unsigned int & height, unsigned int & num_channels);
     virtual void loadFile() = 0;
+    virtual bool probeFile();
     
     std::string filename;
-    std::unique_ptr<ImageData> data;
+    std::shared_ptr<ImageData> data;
+    unsigned int probed_width = 0, probed_height = 0, probed_num_channels = 0;
 
   private:
+    std::shared_future<void> pending_load;
     float display_scale;
   };
 };
@@ -2,39 +2,47 @@
 #define _IMAGEDATA_H_
 
 #include <Color.h>
+#include <PixelBuffer.h>
+#include <ResizeOptions.h>
 
 #include <cstring>
 #include <memory>
 
 namespace canvas {
+  class ImageDataView;
+
   class ImageData {
   public:
     static ImageData nullImage;
 
   ImageData() : width(0), height(0), num_channels(0) { }
-  ImageData(const unsigned char * _data, unsigned short _width, unsigned short _height, unsigned short _num_channels)
+  ImageData(const unsigned char * _data, unsigned int _width, unsigned int _height, unsigned short _num_channels)
     : width(_width), height(_height), num_channels(_num_channels)
     {
       size_t s = calculateSize();
-      data = std::unique_ptr<unsigned char[]>(new unsigned char[s]);
+      data = allocatePixelBuffer(s);
       if (!_data) {
 	memset(data.get(), 0, s);
       } else {
 	memcpy(data.get(), _data, s);
       }
     }
-  ImageData(unsigned short _width, unsigned short _height, unsigned short _num_channels)
+    // Buffers that are about to be fully overwritten can skip zero_fill
+  ImageData(unsigned int _width, unsigned int _height, unsigned short _num_channels, bool zero_fill = true)
     : width(_width), height(_height), num_channels(_num_channels) {
       size_t s = calculateSize();
-      data = std::unique_ptr<unsigned char[]>(new unsigned char[s]);
-      memset(data.get(), 0, s);  
+      data = allocatePixelBuffer(s);
+      if (zero_fill) memset(data.get(), 0, s);
     }
+    // Takes ownership of _data without copying; it is released through its deleter
+  ImageData(PixelBuffer _data, unsigned int _width, unsigned int _height, unsigned short _num_channels)
+    : width(_width), height(_height), num_channels(_num_channels), data(std::move(_data)) { }
 
     ImageData(const ImageData & other)
       : width(other.getWidth()), height(other.getHeight()), num_channels(other.num_channels)
     {
       size_t s = calculateSize();
-      data = std::unique_ptr<unsigned char[]>(new unsigned char[s]);
+      data = allocatePixelBuffer(s);
       if (other.getData()) {
 	memcpy(data.get(), other.getData(), s);
       } else {
@@ -42,26 +50,36 @@ namespace canvas {
       }
     }
 
+    // Copies the pixels of a possibly strided view
+    explicit ImageData(const ImageDataView & view);
+
     ImageData & operator=(const ImageData & other) = delete;
     
-    std::unique_ptr<ImageData> scale(unsigned short target_width, unsigned short target_height) const;
+    std::unique_ptr<ImageData> scale(unsigned int target_width, unsigned int target_height, const ResizeOptions & options = ResizeOptions()) const;
+    // Halves the image with a 2x2 box filter for as long as it stays at
+    // least the target size, leaving less work for scale(). The buffer is
+    // then shrunk to the reduced size.
+    void reduce(unsigned int target_width, unsigned int target_height);
     std::unique_ptr<ImageData> colorize(const Color & color) const;
     std::unique_ptr<ImageData> blur(float hradius, float vradius) const;
+    double calculatePSNR(const ImageData & other, bool include_alpha = true) const;
+    double calculateSSIM(const ImageData & other) const;
 
     bool isValid() const { return width != 0 && height != 0 && num_channels != 0; }
-    unsigned short getWidth() const { return width; }
-    unsigned short getHeight() const { return height; }
+    unsigned int getWidth() const { return width; }
+    unsigned int getHeight() const { return height; }
     unsigned short getNumChannels() const { return num_channels; }
 
     unsigned char * getData() { return data.get(); }
     const unsigned char * getData() const { return data.get(); }
     
-    static size_t calculateSize(unsigned short width, unsigned short height, unsigned short num_channels) { return width * height * num_channels; }
+    static size_t calculateSize(unsigned int width, unsigned int height, unsigned short num_channels) { return size_t(width) * height * num_channels; }
     size_t calculateSize() const { return calculateSize(width, height, num_channels); }
     
   private:
-    unsigned short width, height, num_channels;
-    std::unique_ptr<unsigned char[]> data;
+    unsigned int width, height;
+    unsigned short num_channels;
+    PixelBuffer data;
   };
 };
 #endif
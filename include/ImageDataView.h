@@ -0,0 +1,51 @@
+#ifndef _IMAGEDATAVIEW_H_
+#define _IMAGEDATAVIEW_H_
+
+#include <ImageData.h>
+
+#include <cassert>
+#include <memory>
+
+namespace canvas {
+  // Non-owning view of 8-bit pixels. Rows may be further apart than
+  // width * num_channels, so sub-rectangles and locked surfaces can be
+  // processed in place.
+  class ImageDataView {
+  public:
+    ImageDataView() : data(0), width(0), height(0), num_channels(0), stride(0) { }
+    ImageDataView(const unsigned char * _data, unsigned int _width, unsigned int _height, unsigned short _num_channels, size_t _stride = 0)
+      : data(_data), width(_width), height(_height), num_channels(_num_channels),
+	stride(_stride ? _stride : size_t(_width) * _num_channels) { }
+    ImageDataView(const ImageData & image)
+      : ImageDataView(image.getData(), image.getWidth(), image.getHeight(), image.getNumChannels()) { }
+
+    ImageDataView crop(unsigned int x, unsigned int y, unsigned int w, unsigned int h) const {
+      assert(x + w <= width && y + h <= height);
+      return ImageDataView(getRow(y) + size_t(x) * num_channels, w, h, num_channels, stride);
+    }
+
+    // Output rows are resampled in parallel strips. Exact 2:1 and 4:1
+    // reductions with the default or box filter use a SIMD box filter.
+    std::unique_ptr<ImageData> scale(unsigned int target_width, unsigned int target_height, const ResizeOptions & options = ResizeOptions()) const;
+    std::unique_ptr<ImageData> colorize(const Color & color) const;
+    std::unique_ptr<ImageData> blur(float hradius, float vradius) const;
+
+    bool isValid() const { return data && width != 0 && height != 0 && num_channels != 0; }
+    bool isContiguous() const { return stride == size_t(width) * num_channels; }
+    unsigned int getWidth() const { return width; }
+    unsigned int getHeight() const { return height; }
+    unsigned short getNumChannels() const { return num_channels; }
+    size_t getStride() const { return stride; }
+
+    const unsigned char * getData() const { return data; }
+    const unsigned char * getRow(unsigned int y) const { return data + y * stride; }
+
+  private:
+    const unsigned char * data;
+    unsigned int width, height;
+    unsigned short num_channels;
+    size_t stride;
+  };
+};
+
+#endif
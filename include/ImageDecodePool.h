@@ -0,0 +1,49 @@
+#ifndef _IMAGEDECODEPOOL_H_
+#define _IMAGEDECODEPOOL_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace canvas {
+  // Fixed set of worker threads running queued tasks, highest priority
+  // first and in submission order within a priority. Tasks that are still
+  // queued when the pool is destroyed are run before the workers exit.
+  class ImageDecodePool {
+  public:
+    ImageDecodePool(unsigned int num_threads = 0);
+    ImageDecodePool(const ImageDecodePool & other) = delete;
+    ImageDecodePool & operator=(const ImageDecodePool & other) = delete;
+    ~ImageDecodePool();
+
+    void enqueue(int priority, std::function<void()> task);
+
+    unsigned int getNumThreads() const { return (unsigned int)threads.size(); }
+    size_t getQueueSize() const;
+
+  private:
+    struct Task {
+      int priority;
+      unsigned long long sequence;
+      std::function<void()> func;
+
+      bool operator<(const Task & other) const {
+	return priority < other.priority || (priority == other.priority && sequence > other.sequence);
+      }
+    };
+
+    void run();
+
+    std::vector<std::thread> threads;
+    std::priority_queue<Task> tasks;
+    mutable std::mutex mutex;
+    std::condition_variable cond;
+    unsigned long long next_sequence = 0;
+    bool stopping = false;
+  };
+};
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef _LRUCACHE_H_
+#define _LRUCACHE_H_
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace canvas {
+  // Thread-safe cache of shared values that evicts the least recently used
+  // entries once the total size exceeds the byte budget. Values that are
+  // still referenced elsewhere stay alive after eviction.
+  template<class Key, class Value, class Hash = std::hash<Key> >
+  class LRUCache {
+  public:
+    struct Statistics {
+      size_t hits = 0, misses = 0, evictions = 0;
+      size_t entries = 0, bytes = 0;
+    };
+
+    LRUCache(size_t _budget) : budget(_budget) { }
+    LRUCache(const LRUCache & other) = delete;
+    LRUCache & operator=(const LRUCache & other) = delete;
+
+    std::shared_ptr<Value> get(const Key & key) {
+      std::lock_guard<std::mutex> guard(mutex);
+      auto it = index.find(key);
+      if (it == index.end()) {
+	stats.misses++;
+	return std::shared_ptr<Value>();
+      }
+      stats.hits++;
+      entries.splice(entries.begin(), entries, it->second);
+      return it->second->value;
+    }
+
+    void put(const Key & key, std::shared_ptr<Value> value, size_t size) {
+      std::lock_guard<std::mutex> guard(mutex);
+      auto it = index.find(key);
+      if (it != index.end()) {
+	remove(it->second);
+      }
+      if (size > budget) return;
+      entries.push_front(Entry { key, std::move(value), size });
+      index[key] = entries.begin();
+      stats.bytes += size;
+      stats.entries++;
+      trim(budget);
+    }
+
+    void erase(const Key & key) {
+      std::lock_guard<std::mutex> guard(mutex);
+      auto it = index.find(key);
+      if (it != index.end()) remove(it->second);
+    }
+
+    void clear() {
+      std::lock_guard<std::mutex> guard(mutex);
+      entries.clear();
+      index.clear();
+      stats.entries = stats.bytes = 0;
+    }
+
+    void setBudget(size_t _budget) {
+      std::lock_guard<std::mutex> guard(mutex);
+      budget = _budget;
+      trim(budget);
+    }
+    size_t getBudget() const {
+      std::lock_guard<std::mutex> guard(mutex);
+      return budget;
+    }
+
+    Statistics getStatistics() const {
+      std::lock_guard<std::mutex> guard(mutex);
+      return stats;
+    }
+
+  private:
+    struct Entry {
+      Key key;
+      std::shared_ptr<Value> value;
+      size_t size;
+    };
+    typedef typename std::list<Entry>::iterator EntryIterator;
+
+    void remove(EntryIterator it) {
+      stats.bytes -= it->size;
+      stats.entries--;
+      index.erase(it->key);
+      entries.erase(it);
+    }
+
+    void trim(size_t max_bytes) {
+      while (stats.bytes > max_bytes && !entries.empty()) {
+	remove(std::prev(entries.end()));
+	stats.evictions++;
+      }
+    }
+
+    size_t budget;
+    std::list<Entry> entries; // most recently used first
+    std::unordered_map<Key, EntryIterator, Hash> index;
+    Statistics stats;
+    mutable std::mutex mutex;
+  };
+};
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef _MAPPEDFILE_H_
+#define _MAPPEDFILE_H_
+
+#include <string>
+#include <cstddef>
+
+namespace canvas {
+  // Read-only view of a whole file. The file is memory mapped where
+  // possible and read into memory otherwise.
+  class MappedFile {
+  public:
+    MappedFile(const std::string & filename);
+    MappedFile(const MappedFile & other) = delete;
+    MappedFile & operator=(const MappedFile & other) = delete;
+    ~MappedFile();
+
+    bool isValid() const { return data != 0; }
+    const unsigned char * getData() const { return data; }
+    size_t getSize() const { return size; }
+
+    // Hints that the mapping will be read once from start to end
+    void adviseSequential();
+
+  private:
+    unsigned char * data = 0;
+    size_t size = 0;
+    bool is_mapped = false;
+  };
+};
+
+#endif
@@ -3,15 +3,20 @@
 
 #include <Point.h>
 #include <cmath>
+#include <cstddef>
 
 namespace canvas {
   class Matrix {
   public:
-  Matrix() : a(1.0), b(0.0), c(0.0), d(1.0), e(0.0), f(0.0) { }
+    // What the matrix does, so that points can skip the unused terms.
+    // Each type includes the ones before it.
+    enum Type { IDENTITY = 0, TRANSLATE, SCALE, AFFINE };
+    
+  Matrix() : a(1.0), b(0.0), c(0.0), d(1.0), e(0.0), f(0.0), type(IDENTITY) { }
   Matrix(double _a, double _b, double _c, double _d, double _e, double _f)
-    : a(_a), b(_b), c(_c), d(_d), e(_e), f(_f) { }
+    : a(_a), b(_b), c(_c), d(_d), e(_e), f(_f), type(classify()) { }
     
-    Matrix operator* (const Matrix & other) {
+    Matrix operator* (const Matrix & other) const {
       return multiply(*this, other);    
     }
     
@@ -21,22 +26,45 @@ namespace canvas {
     }
     
     Point multiply(double x, double y) const {
-      return Point( x * a + y * c + e,
-		    x * b + y * d + f
-		    );    
+      switch (type) {
+      case IDENTITY: return Point(x, y);
+      case TRANSLATE: return Point(x + e, y + f);
+      case SCALE: return Point(x * a + e, y * d + f);
+      default:
+	return Point( x * a + y * c + e,
+		      x * b + y * d + f
+		      );
+      }
     }
     
     Point multiply(const Point & p) const {
       return multiply(p.x, p.y);
     }
+
+    // Transforms count interleaved x, y pairs; out may equal in
+    void multiply(const float * in, float * out, size_t count) const;
     
-    double transformAngle(double alpha) {
+    double transformAngle(double alpha) const {
+      if (type <= TRANSLATE || (type == SCALE && a == d && a > 0)) {
+	return alpha;
+      }
       double x = cos(alpha), y = sin(alpha);
       return atan2(x * b + y * d, x * a + y * c);
     }
+
+    Type getType() const { return type; }
     
   private:
+    Type classify() const {
+      if (b != 0.0 || c != 0.0) return AFFINE;
+      if (a != 1.0 || d != 1.0) return SCALE;
+      if (e != 0.0 || f != 0.0) return TRANSLATE;
+      return IDENTITY;
+    }
+    
     static Matrix multiply(const Matrix & A, const Matrix & B) {
+      if (B.type == IDENTITY) return A;
+      if (A.type == IDENTITY) return B;
       return Matrix( A.a * B.a + A.c * B.b,
 		     A.b * B.a + A.d * B.b,
 		     A.a * B.c + A.c * B.d,
@@ -47,6 +75,7 @@ namespace canvas {
     }
     
     double a, b, c, d, e, f;
+    Type type;
   };
 };
 
@@ -0,0 +1,22 @@
+#ifndef _ORDEREDDITHER_H_
+#define _ORDEREDDITHER_H_
+
+#include <InternalFormat.h>
+
+#include <cstddef>
+
+namespace canvas {
+  class ImageDataView;
+
+  class OrderedDither {
+  public:
+    OrderedDither(InternalFormat _target_format) : target_format(_target_format) { }
+
+    size_t apply(const ImageDataView & input_image, unsigned char * output) const;
+
+  private:
+    InternalFormat target_format;
+  };
+};
+
+#endif
@@ -2,25 +2,64 @@
 #define _PACKEDIMAGEDATA_H_
 
 #include <InternalFormat.h>
+#include <Dithering.h>
+#include <PixelBuffer.h>
 
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace canvas {
   class ImageData;
+  class ImageDataView;
   
   class PackedImageData {
   public:
   PackedImageData() : format(NO_FORMAT), width(0), height(0), levels(0), quality(0) { }
-    PackedImageData(InternalFormat _format, unsigned short _levels, const ImageData & input);
-    PackedImageData(InternalFormat _format, unsigned short _width, unsigned short _height, unsigned short _levels, const unsigned char * input = 0);
+    // quality selects the ETC1 encoder quality (0 = low, 1 = medium, 2 = high)
+    // and the DXT refinement mode (1 and above = high quality)
+    PackedImageData(InternalFormat _format, unsigned short _levels, const ImageDataView & input, Dithering dithering = FLOYD_STEINBERG, unsigned short _quality = 0);
+    PackedImageData(InternalFormat _format, unsigned int _width, unsigned int _height, unsigned short _levels, const unsigned char * input = 0);
+    // Adopts existing level data. If level_offsets is empty, the levels are
+    // laid out contiguously as given by calculateOffset().
+    PackedImageData(InternalFormat _format, unsigned int _width, unsigned int _height, unsigned short _levels, PixelBuffer _data, std::vector<size_t> _level_offsets = std::vector<size_t>())
+      : format(_format), width(_width), height(_height), levels(_levels), quality(0), data(std::move(_data)), level_offsets(std::move(_level_offsets)) { }
   
     void setQuality(unsigned short _quality) { quality = _quality; }
     unsigned short getQuality() const { return quality; }
     
-    unsigned short getWidth() const { return width; }
-    unsigned short getHeight() const { return height; }
+    unsigned int getWidth() const { return width; }
+    unsigned int getHeight() const { return height; }
+    unsigned short getLevels() const { return levels; }
     InternalFormat getInternalFormat() const { return format; }
 
+    // Decodes a level back into 8-bit channels
+    std::unique_ptr<ImageData> unpack(unsigned short level = 0) const;
+    // Decodes a level and compares it with the original image
+    double calculatePSNR(const ImageData & original, unsigned short level = 0) const;
+
+    static unsigned short getNumChannels(InternalFormat format) {
+      switch (format) {
+      case NO_FORMAT: return 0;
+      case R8: return 1;
+      case RG8: return 2;
+      case RGB565: return 3;
+      case RGBA4: return 4;
+      case RGBA8: return 4;
+      case RGB8: return 4;
+      case RED_RGTC1: return 1;
+      case RG_RGTC2: return 2;
+      case RGB_DXT1: return 3;
+      case RGBA_DXT5: return 4;
+      case RGB_ETC1: return 3;
+      case LUMINANCE_ALPHA: return 2;
+      case LA44: return 2;
+      case R32F: return 1;
+      case RGBA5551: return 4;
+      }
+      return 0;
+    }
+
     static unsigned short getBytesPerPixel(InternalFormat format) {
       switch (format) {
       case NO_FORMAT: return 0;
@@ -43,23 +82,23 @@ namespace canvas {
       return 0;
     }
 
-    static size_t calculateOffset(unsigned short width, unsigned short height, unsigned short level, InternalFormat format) {
+    static size_t calculateOffset(unsigned int width, unsigned int height, unsigned short level, InternalFormat format) {
       size_t s = 0;
       if (format == RGB_ETC1 || format == RGB_DXT1 || format == RED_RGTC1) {
 	for (unsigned int l = 0; l < level; l++) {
-	  s += 8 * ((width + 3) / 4) * ((height + 3) / 4);
+	  s += 8 * size_t((width + 3) / 4) * ((height + 3) / 4);
 	  width = (width + 1) / 2;
 	  height = (height + 1) / 2;
 	}
-      } else if (format == RG_RGTC2) {
+      } else if (format == RG_RGTC2 || format == RGBA_DXT5) {
 	for (unsigned int l = 0; l < level; l++) {
-	  s += 16 * ((width + 3) / 4) * ((height + 3) / 4);
+	  s += 16 * size_t((width + 3) / 4) * ((height + 3) / 4);
 	  width = (width + 1) / 2;
 	  height = (height + 1) / 2;
 	}
       } else {
 	for (unsigned int l = 0; l < level; l++) {
-	  s += width * height * getBytesPerPixel(format);
+	  s += size_t(width) * height * getBytesPerPixel(format);
 	  width = (width + 1) / 2;
 	  height = (height + 1) / 2;
 	}
@@ -71,7 +110,7 @@ namespace canvas {
       return calculateOffset(width, height, level, format);
     }
 
-    static size_t calculateSize(unsigned short width, unsigned short height, unsigned short levels, InternalFormat format) {
+    static size_t calculateSize(unsigned int width, unsigned int height, unsigned short levels, InternalFormat format) {
       return calculateOffset(width, height, levels, format);
     }
     
@@ -83,17 +122,26 @@ namespace canvas {
     }
 
     const unsigned char * getData() const { return data.get(); }
-    const unsigned char * getDataForLevel(unsigned short level) {
-      return data.get() + calculateOffset(level);
+    const unsigned char * getDataForLevel(unsigned short level) const {
+      return data.get() + (level_offsets.empty() ? calculateOffset(level) : level_offsets[level]);
     }
 
+    // Container files. Loaded files are memory mapped and the levels point
+    // directly into the mapping whenever the stored layout allows it.
+    bool saveKTX(const std::string & filename) const;
+    bool saveDDS(const std::string & filename) const;
+    static std::unique_ptr<PackedImageData> loadFile(const std::string & filename);
+
+    static bool isKTX(const unsigned char * buffer, size_t size);
+    static bool isDDS(const unsigned char * buffer, size_t size);
+
   private:
     InternalFormat format;
-    unsigned short width, height, levels;
+    unsigned int width, height;
+    unsigned short levels;
     unsigned short quality;
-    std::unique_ptr<unsigned char[]> data;
-    
-    static bool etc1_initialized;
+    PixelBuffer data;
+    std::vector<size_t> level_offsets;
   };
 };
 
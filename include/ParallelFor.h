@@ -0,0 +1,32 @@
+#ifndef _CANVAS_PARALLELFOR_H_
+#define _CANVAS_PARALLELFOR_H_
+
+#include <thread>
+#include <vector>
+
+namespace canvas {
+  // Splits [0, count) into contiguous ranges of at least min_chunk items
+  // and calls fn(begin, end) for each range on its own thread. The calling
+  // thread processes the first range.
+  template<class F>
+  void parallelFor(unsigned int count, unsigned int min_chunk, F fn) {
+    unsigned int num_threads = std::thread::hardware_concurrency();
+    if (min_chunk == 0) min_chunk = 1;
+    if (num_threads > count / min_chunk) num_threads = count / min_chunk;
+    if (num_threads <= 1) {
+      if (count) fn(0u, count);
+      return;
+    }
+    unsigned int chunk = (count + num_threads - 1) / num_threads;
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads - 1);
+    for (unsigned int begin = chunk; begin < count; begin += chunk) {
+      unsigned int end = begin + chunk < count ? begin + chunk : count;
+      threads.push_back(std::thread([=]() { fn(begin, end); }));
+    }
+    fn(0u, chunk);
+    for (auto & t : threads) t.join();
+  }
+};
+
+#endif
@@ -2,82 +2,293 @@
 #define _CANVAS_PATH2D_H_
 
 #include <Point.h>
+#include <Matrix.h>
+#include <FillRule.h>
+#include <TriangleMesh.h>
+#include <cstddef>
+#include <memory>
 #include <vector>
 
 namespace canvas {
   class PathComponent {
   public:
-    enum Type { MOVE_TO = 1, LINE_TO, ARC, CLOSE };
+    enum Type { MOVE_TO = 1, LINE_TO, ARC, CLOSE, QUADRATIC_TO, CUBIC_TO };
 
-  PathComponent(Type _type) : type(_type), x0(0), y0(0), radius(0), sa(0), ea(0), anticlockwise(false) { }
-  PathComponent(Type _type, double _x0, double _y0) : type(_type), x0(_x0), y0(_y0), radius(0), sa(0), ea(0), anticlockwise(false) { }
-  PathComponent(Type _type, double _x0, double _y0, double _radius, double _sa, double _ea, bool _anticlockwise) : type(_type), x0(_x0), y0(_y0), radius(_radius), sa(_sa), ea(_ea), anticlockwise(_anticlockwise) { }
+  PathComponent(Type _type) : type(_type), x0(0), y0(0), radius(0), sa(0), ea(0), anticlockwise(false), radius_y(0), rotation(0), cx0(0), cy0(0), cx1(0), cy1(0) { }
+  PathComponent(Type _type, double _x0, double _y0) : type(_type), x0(_x0), y0(_y0), radius(0), sa(0), ea(0), anticlockwise(false), radius_y(0), rotation(0), cx0(0), cy0(0), cx1(0), cy1(0) { }
+  PathComponent(Type _type, double _x0, double _y0, double _radius, double _sa, double _ea, bool _anticlockwise) : type(_type), x0(_x0), y0(_y0), radius(_radius), sa(_sa), ea(_ea), anticlockwise(_anticlockwise), radius_y(_radius), rotation(0), cx0(0), cy0(0), cx1(0), cy1(0) { }
+  PathComponent(Type _type, double _x0, double _y0, double _radius, double _radius_y, double _rotation, double _sa, double _ea, bool _anticlockwise) : type(_type), x0(_x0), y0(_y0), radius(_radius), sa(_sa), ea(_ea), anticlockwise(_anticlockwise), radius_y(_radius_y), rotation(_rotation), cx0(0), cy0(0), cx1(0), cy1(0) { }
+  PathComponent(Type _type, double _cx0, double _cy0, double _cx1, double _cy1, double _x0, double _y0) : type(_type), x0(_x0), y0(_y0), radius(0), sa(0), ea(0), anticlockwise(false), radius_y(0), rotation(0), cx0(_cx0), cy0(_cy0), cx1(_cx1), cy1(_cy1) { }
       
     Type type;
     double x0, y0, radius, sa, ea;
     bool anticlockwise;
+    // an ARC is elliptical when radius_y differs from radius or it is rotated
+    double radius_y, rotation;
+    // control points of QUADRATIC_TO (cx0, cy0) and CUBIC_TO (both)
+    double cx0, cy0, cx1, cy1;
+
+    // Signed sweep of an arc from sa to ea, at most one full turn
+    static double getArcSpan(double sa, double ea, bool anticlockwise);
+
+    // Point at parametric angle a on an ellipse rotated around its center
+    static Point getEllipsePoint(const Point & c, double rx, double ry, double rotation, double a) {
+      double x = rx * cos(a), y = ry * sin(a);
+      if (rotation == 0) return Point(c.x + x, c.y + y);
+      double cr = cos(rotation), sr = sin(rotation);
+      return Point(c.x + x * cr - y * sr, c.y + x * sr + y * cr);
+    }
+    Point getArcPoint(double a) const { return getEllipsePoint(Point(x0, y0), radius, radius_y, rotation, a); }
+    bool isCircular() const { return radius == radius_y && rotation == 0; }
+
+    // number of x, y pairs a component of the given type stores
+    static size_t getNumPoints(Type type) {
+      switch (type) {
+      case CLOSE: return 0;
+      case QUADRATIC_TO: return 2;
+      case CUBIC_TO: return 3;
+      default: return 1;
+      }
+    }
   };
   
   class Path2D {
   public:
-    Path2D() : current_point(0, 0) { }
+    // Walks the path, yielding each component by value
+    class const_iterator {
+    public:
+      const_iterator(const Path2D * _path, size_t _verb, size_t _point, size_t _arc)
+	: path(_path), verb(_verb), point(_point), arc(_arc) { }
+
+      PathComponent operator*() const {
+	PathComponent::Type type = PathComponent::Type(path->verbs[verb]);
+	if (type == PathComponent::CLOSE) {
+	  return PathComponent(type);
+	}
+	const float * p = &(path->points[2 * point]);
+	if (type == PathComponent::QUADRATIC_TO) {
+	  return PathComponent(type, p[0], p[1], 0, 0, p[2], p[3]);
+	} else if (type == PathComponent::CUBIC_TO) {
+	  return PathComponent(type, p[0], p[1], p[2], p[3], p[4], p[5]);
+	}
+	double x = p[0], y = p[1];
+	if (type == PathComponent::ARC) {
+	  auto & a = path->arcs[arc];
+	  return PathComponent(type, x, y, a.radius, a.radius_y, a.rotation, a.sa, a.ea, a.anticlockwise);
+	}
+	return PathComponent(type, x, y);
+      }
+      const_iterator & operator++() {
+	PathComponent::Type type = PathComponent::Type(path->verbs[verb++]);
+	point += PathComponent::getNumPoints(type);
+	if (type == PathComponent::ARC) arc++;
+	return *this;
+      }
+      bool operator==(const const_iterator & other) const { return verb == other.verb; }
+      bool operator!=(const const_iterator & other) const { return verb != other.verb; }
+
+    private:
+      const Path2D * path;
+      size_t verb, point, arc;
+    };
+
+    struct ArcParameters {
+      double radius, sa, ea;
+      bool anticlockwise;
+      double radius_y, rotation;
+    };
+
+    Path2D() : current_point(0, 0), subpath_start(0, 0), bounds_min(0, 0), bounds_max(0, 0), has_bounds(false) { }
     
     void moveTo(const Point & p) {
-      data.push_back(PathComponent(PathComponent::MOVE_TO, p.x, p.y));
-      current_point = p;
+      addVerb(PathComponent::MOVE_TO, p);
+      extend(p);
+      current_point = subpath_start = p;
     }
     void lineTo(const Point & p) {
-      data.push_back(PathComponent(PathComponent::LINE_TO, p.x, p.y));
+      addVerb(PathComponent::LINE_TO, p);
+      extend(p);
       current_point = p;
     }
     void closePath() {
-      if (!data.empty()) {
-	data.push_back(PathComponent(PathComponent::CLOSE));
-	current_point = Point(data.front().x0, data.front().y0);
+      if (!verbs.empty()) {
+	verbs.push_back(PathComponent::CLOSE);
+	fill_mesh.reset();
+	current_point = subpath_start;
       }
     }
-    void arc(const Point & p, double radius, double sa, double ea, bool anticlockwise);
+    // Appends count interleaved x, y pairs transformed by m
+    void lineTo(const float * xy, size_t count, const Matrix & m = Matrix());
+    void quadraticCurveTo(const Point & cp, const Point & p) {
+      if (verbs.empty()) moveTo(cp);
+      extendQuadratic(current_point, cp, p);
+      addVerb(PathComponent::QUADRATIC_TO, cp);
+      addPoint(p);
+      current_point = p;
+    }
+    void bezierCurveTo(const Point & cp1, const Point & cp2, const Point & p) {
+      if (verbs.empty()) moveTo(cp1);
+      extendCubic(current_point, cp1, cp2, p);
+      addVerb(PathComponent::CUBIC_TO, cp1);
+      addPoint(cp2);
+      addPoint(p);
+      current_point = p;
+    }
+    void arc(const Point & p, double radius, double sa, double ea, bool anticlockwise) {
+      ellipse(p, radius, radius, 0, sa, ea, anticlockwise);
+    }
+    void ellipse(const Point & p, double radius_x, double radius_y, double rotation, double sa, double ea, bool anticlockwise);
+    // Closed rectangle with circular corners, transformed by m; the radius
+    // is clamped to half of the shorter side
+    void roundRect(const Point & p, double w, double h, double radius, const Matrix & m = Matrix());
     void arcTo(const Point & p1, const Point & p2, double radius);
 
-    const std::vector<PathComponent> & getData() const { return data; }
+    // Returns a copy for rendering within the box (min_x, min_y) -
+    // (max_x, max_y): vertices within tolerance of the previous one or of
+    // a straight run are dropped. For fills each subpath is clipped as a
+    // polygon, for strokes the segments outside the box are removed. If
+    // column_width is set, consecutive vertices within one column of that
+    // width are first reduced to the first, lowest, highest and last one,
+    // so that dense data such as time series scales with the columns
+    // covered rather than the number of points.
+    Path2D simplify(double tolerance, double min_x, double min_y, double max_x, double max_y, bool fill, double column_width = 0) const;
+
+    // Triangles of the fill and of the stroke, with curves flattened to
+    // tolerance. Results are cached until the path changes; appending to
+    // the path only restrokes the last subpath onwards.
+    std::shared_ptr<const TriangleMesh> getFillMesh(FillRule rule = NONZERO, double tolerance = 0.25) const;
+    std::shared_ptr<const TriangleMesh> getStrokeMesh(double line_width, double tolerance = 0.25) const;
+
+    // Returns a copy with curves and arcs replaced by line segments
+    // that stay within tolerance of the exact outline. Points are
+    // already in canvas space, so the tolerance is in canvas units
+    // (0.25 / displayScale gives a quarter of a device pixel).
+    Path2D flatten(double tolerance) const;
+
+    const_iterator begin() const { return const_iterator(this, 0, 0, 0); }
+    const_iterator end() const { return const_iterator(this, verbs.size(), points.size() / 2, arcs.size()); }
+
+    // Raw storage: one verb per component, an x, y pair for every verb
+    // except CLOSE (control points first for curves, see
+    // PathComponent::getNumPoints), and the remaining parameters of
+    // each ARC
+    const std::vector<unsigned char> & getVerbs() const { return verbs; }
+    const std::vector<float> & getPoints() const { return points; }
+    const std::vector<ArcParameters> & getArcs() const { return arcs; }
+
+    void reserve(size_t n) {
+      verbs.reserve(n);
+      points.reserve(2 * n);
+    }
 
     void clear() {
-      data.clear();
-      current_point = Point(0, 0);
+      invalidateMeshes();
+      verbs.clear();
+      points.clear();
+      arcs.clear();
+      current_point = subpath_start = Point(0, 0);
+      bounds_min = bounds_max = Point(0, 0);
+      has_bounds = false;
     }
 
     const Point & getCurrentPoint() const { return current_point; }
 
+    // Transforms every point in place. Arc radii are kept as they are,
+    // as in GraphicsState::arc.
+    void transform(const Matrix & m);
+
     void offset(double dx, double dy) {
-      for (auto & pc : data) {
-	pc.x0 += dx;
-	pc.y0 += dy;
+      invalidateMeshes();
+      for (size_t i = 0; i < points.size(); i += 2) {
+	points[i] += float(dx);
+	points[i + 1] += float(dy);
       }
+      current_point = Point(current_point.x + dx, current_point.y + dy);
+      subpath_start = Point(subpath_start.x + dx, subpath_start.y + dy);
+      bounds_min = Point(bounds_min.x + dx, bounds_min.y + dy);
+      bounds_max = Point(bounds_max.x + dx, bounds_max.y + dy);
     }
 
+    // Bounds of everything the path covers, maintained as components
+    // are added. Arcs contribute their actual extent, not the center,
+    // and curves their extrema rather than the control points.
     void getExtents(double & min_x, double & min_y, double & max_x, double & max_y) const {
-      if (data.empty()) {
+      if (!has_bounds) {
 	min_x = min_y = max_x = max_y = 0;
       } else {
-	auto it = data.begin();
-	min_x = max_x = it->x0;
-	min_y = max_y = it->y0;
-	for (auto & pc : data) {
-	  if (pc.x0 < min_x) min_x = pc.x0;
-	  if (pc.y0 < min_y) min_y = pc.x0;
-	  if (pc.x0 < max_x) max_x = pc.y0;
-	  if (pc.y0 < max_y) max_y = pc.y0;
-	}
+	min_x = bounds_min.x;
+	min_y = bounds_min.y;
+	max_x = bounds_max.x;
+	max_y = bounds_max.y;
       }
     }
 
-    bool empty() const { return data.empty(); }
-    // bool isInside(float x, float y) const;
-    std::size_t size() const { return data.size(); }
+    bool empty() const { return verbs.empty(); }
+    // true if the path has only moves, lines and closes
+    bool isFlat() const;
+    // Recognize the output of a full circle or ellipse arc and of
+    // roundRect, axis aligned, so that they can be filled analytically
+    bool isEllipse(double & cx, double & cy, double & rx, double & ry) const;
+    bool isRoundRect(double & x0, double & y0, double & x1, double & y1, double & radius) const;
+    // Tests the point against the path with every subpath implicitly
+    // closed. Curves and arcs are flattened with the given tolerance.
+    bool isInside(double x, double y, FillRule rule = NONZERO, double tolerance = 0.1) const;
+    std::size_t size() const { return verbs.size(); }
     
   private:
-    std::vector<PathComponent> data;
-    Point current_point;
+    void updateBounds();
+    void invalidateMeshes() {
+      fill_mesh.reset();
+      stroke_mesh.reset();
+    }
+    void addVerb(PathComponent::Type type, const Point & p) {
+      fill_mesh.reset();
+      if (verbs.empty()) subpath_start = p;
+      verbs.push_back(type);
+      addPoint(p);
+    }
+    void addPoint(const Point & p) {
+      points.push_back(float(p.x));
+      points.push_back(float(p.y));
+    }
+    void extend(const Point & p) {
+      if (!has_bounds) {
+	bounds_min = bounds_max = p;
+	has_bounds = true;
+      } else {
+	if (p.x < bounds_min.x) bounds_min.x = p.x;
+	if (p.y < bounds_min.y) bounds_min.y = p.y;
+	if (p.x > bounds_max.x) bounds_max.x = p.x;
+	if (p.y > bounds_max.y) bounds_max.y = p.y;
+      }
+    }
+    void extendEllipse(const Point & p, double rx, double ry, double rotation, double sa, double ea, bool anticlockwise);
+    void extendQuadratic(const Point & p0, const Point & cp, const Point & p);
+    void extendCubic(const Point & p0, const Point & cp1, const Point & cp2, const Point & p);
+
+    std::vector<unsigned char> verbs;
+    std::vector<float> points;
+    std::vector<ArcParameters> arcs;
+    // subpath_start is where closePath() returns to
+    Point current_point, subpath_start, bounds_min, bounds_max;
+    bool has_bounds;
+
+    struct FillMesh {
+      std::shared_ptr<const TriangleMesh> mesh;
+      FillRule rule;
+      double tolerance;
+    };
+    // stroke_mesh also records where its last subpath starts, both in the
+    // path and in the mesh, so that appended components resume from there
+    struct StrokeMesh {
+      std::shared_ptr<const TriangleMesh> mesh;
+      double line_width, tolerance;
+      size_t num_verbs, resume_verb, resume_point, resume_arc;
+      size_t resume_vertices, resume_indices;
+    };
+    // shared by copies, and replaced rather than modified
+    mutable std::shared_ptr<const FillMesh> fill_mesh;
+    mutable std::shared_ptr<const StrokeMesh> stroke_mesh;
   };
 };
 
@@ -0,0 +1,62 @@
+#ifndef _PIXELBUFFER_H_
+#define _PIXELBUFFER_H_
+
+#include <functional>
+#include <new>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace canvas {
+  // Pixel storage that is released through its deleter, so that it can be
+  // owned, borrowed from a decoder or backed by a memory mapping.
+  typedef std::function<void(unsigned char *)> PixelBufferDeleter;
+  typedef std::unique_ptr<unsigned char[], PixelBufferDeleter> PixelBuffer;
+
+  // Process-wide cache of 64-byte aligned pixel buffers. Sizes are rounded
+  // up to one of four classes per power of two, and released buffers are
+  // kept for reuse until the pooled total exceeds the limit.
+  class PixelBufferPool {
+  public:
+    static const size_t alignment = 64;
+
+    struct Statistics {
+      size_t live_bytes = 0, peak_bytes = 0, pooled_bytes = 0;
+      size_t allocations = 0, reuses = 0;
+    };
+
+    static PixelBufferPool & getInstance();
+
+    // The returned memory is not initialized
+    PixelBuffer allocate(size_t size);
+    // Frees all pooled buffers
+    void trim();
+
+    void setMaxPooledBytes(size_t bytes);
+    // Buffers of at least this size are advised to use transparent huge
+    // pages where supported. 0 disables the advice.
+    void setHugePageThreshold(size_t bytes);
+
+    Statistics getStatistics() const;
+
+    static size_t getSizeClass(size_t size);
+
+  private:
+    PixelBufferPool() { }
+    void release(unsigned char * ptr, size_t size_class);
+    void trimTo(size_t max_bytes);
+
+    std::unordered_map<size_t, std::vector<unsigned char *> > free_buffers;
+    size_t max_pooled_bytes = 64 * 1024 * 1024;
+    size_t huge_page_threshold = 0;
+    Statistics stats;
+    mutable std::mutex mutex;
+  };
+
+  inline PixelBuffer allocatePixelBuffer(size_t size) {
+    return PixelBufferPool::getInstance().allocate(size);
+  }
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef _CANVAS_RASTERIZER_H_
+#define _CANVAS_RASTERIZER_H_
+
+#include <Path2D.h>
+#include <FillRule.h>
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace canvas {
+  // Scanline polygon filler for paths in device space. Coverage is exact
+  // horizontally and sampled at a number of sub-scanlines vertically, so
+  // both fill rules are supported. Paths that are a full axis aligned
+  // ellipse or a round rect are filled analytically instead.
+  class Rasterizer {
+  public:
+    Rasterizer() : shape(SHAPE_PATH) { }
+
+    // Builds the edge list from the path scaled by scale and then offset
+    // by (dx, dy). Curves and arcs are flattened to a quarter pixel.
+    // Recognized shapes keep only their parameters.
+    void setPath(const Path2D & path, double scale = 1.0, double dx = 0.0, double dy = 0.0);
+    bool empty() const { return shape == SHAPE_PATH && edges.empty(); }
+
+    // Writes antialiased coverage for every pixel of an R8 mask
+    void fill(unsigned char * mask, unsigned int width, unsigned int height, size_t stride, FillRule rule, unsigned int samples = 4) const;
+    // Calls fn(y, x0, x1) for each run [x0, x1) of pixels whose centers are inside
+    void getSpans(unsigned int width, unsigned int height, FillRule rule, const std::function<void(unsigned int, unsigned int, unsigned int)> & fn) const;
+
+  private:
+    enum Shape { SHAPE_PATH = 1, SHAPE_ELLIPSE, SHAPE_ROUND_RECT };
+    
+    // Coverage from the signed distance to the shape at the pixel center.
+    // Each row is written from both ends inwards until full coverage,
+    // and the interior is filled in one go.
+    void fillShape(unsigned char * mask, unsigned int width, unsigned int height, size_t stride) const;
+    double getShapeCoverage(double x, double y) const;
+    // Horizontal extent of the shape on the line y, false if it misses
+    bool getShapeSpan(double y, double & x0, double & x1) const;
+    
+    struct Edge {
+      float x0, y0, y1, dxdy;
+      int winding;
+    };
+    
+    // Walks count sample lines starting at y0, step apart, and calls fn
+    // with the sorted [start, end) pairs of the inside spans on each
+    void scan(double y0, double step, unsigned int count, FillRule rule, const std::function<void(unsigned int, const std::vector<float> &)> & fn) const;
+    void addEdge(double x0, double y0, double x1, double y1);
+
+    std::vector<Edge> edges;
+    Shape shape;
+    // shape bounds, the ellipse radii or the corner radius in device space
+    double shape_x0, shape_y0, shape_x1, shape_y1, shape_rx, shape_ry;
+  };
+};
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef _RESIZEOPTIONS_H_
+#define _RESIZEOPTIONS_H_
+
+namespace canvas {
+  enum ResizeFilter {
+    RESIZE_FILTER_DEFAULT = 0, // Catmull-Rom when upscaling, Mitchell when downscaling, box for exact 2:1 and 4:1
+    RESIZE_FILTER_BOX,
+    RESIZE_FILTER_TRIANGLE,
+    RESIZE_FILTER_CUBIC_BSPLINE,
+    RESIZE_FILTER_CATMULL_ROM,
+    RESIZE_FILTER_MITCHELL
+  };
+
+  enum ResizeEdgeMode {
+    RESIZE_EDGE_CLAMP = 1,
+    RESIZE_EDGE_REFLECT,
+    RESIZE_EDGE_WRAP,
+    RESIZE_EDGE_ZERO
+  };
+
+  struct ResizeOptions {
+    ResizeFilter filter = RESIZE_FILTER_DEFAULT;
+    ResizeEdgeMode edge_mode = RESIZE_EDGE_CLAMP;
+    // filter in linear light instead of on the stored sRGB values
+    bool srgb = false;
+    // false if color is not yet multiplied by alpha, in which case it is
+    // weighted by alpha while filtering
+    bool premultiplied_alpha = true;
+  };
+};
+
+#endif
@@ -11,7 +11,9 @@
 #include <Operator.h>
 #include <InternalFormat.h>
 #include <ImageData.h>
+#include <ImageDataView.h>
 #include <PackedImageData.h>
+#include <CoverageMaskCache.h>
 
 #include <memory>
 #include <cassert>
@@ -56,6 +58,16 @@ namespace canvas {
 	  
     virtual void drawImage(Surface & _img, const Point & p, double w, double h, float displayScale, float globalAlpha, float shadowBlur, float shadowOffsetX, float shadowOffsetY, const Color & shadowColor, const Path2D & clipPath, bool imageSmoothingEnabled = true) = 0;
     virtual void drawImage(const ImageData & _img, const Point & p, double w, double h, float displayScale, float globalAlpha, float shadowBlur, float shadowOffsetX, float shadowOffsetY, const Color & shadowColor, const Path2D & clipPath, bool imageSmoothingEnabled = true) = 0;
+    // Backends that can't draw strided pixels directly draw a compacted copy
+    virtual void drawImage(const ImageDataView & _img, const Point & p, double w, double h, float displayScale, float globalAlpha, float shadowBlur, float shadowOffsetX, float shadowOffsetY, const Color & shadowColor, const Path2D & clipPath, bool imageSmoothingEnabled = true) {
+      drawImage(ImageData(_img), p, w, h, displayScale, globalAlpha, shadowBlur, shadowOffsetX, shadowOffsetY, shadowColor, clipPath, imageSmoothingEnabled);
+    }
+    // Composites the color of a cached coverage mask whose top left corner
+    // is at device pixel (x, y). The default draws the cached colorized
+    // image; surfaces with a native mask blit can use the R8 mask instead.
+    virtual void drawMask(const CoverageMask & mask, int x, int y, float displayScale, float globalAlpha) {
+      drawImage(*mask.image, Point(x / displayScale, y / displayScale), mask.mask.getWidth() / displayScale, mask.mask.getHeight() / displayScale, displayScale, globalAlpha, 0.0f, 0.0f, 0.0f, Color(), Path2D(), false);
+    }
     virtual std::unique_ptr<Image> createImage(float display_scale) = 0;
 
     std::unique_ptr<PackedImageData> createPackedImage() {
@@ -71,15 +83,15 @@ namespace canvas {
     }
 
     std::unique_ptr<ImageData> blur(float hradius, float vradius) {
-      ImageData tmp((unsigned char *)lockMemory(false), getActualWidth(), getActualHeight(), getNumChannels());
-      auto r = tmp.blur(hradius, vradius);
+      ImageDataView view((const unsigned char *)lockMemory(false), getActualWidth(), getActualHeight(), getNumChannels());
+      auto r = view.blur(hradius, vradius);
       releaseMemory();
       return r;
     }
     
     std::unique_ptr<ImageData> colorize(const Color & color) {
-      ImageData tmp((unsigned char *)lockMemory(false), getActualWidth(), getActualHeight(), getNumChannels());
-      auto r = tmp.colorize(color);
+      ImageDataView view((const unsigned char *)lockMemory(false), getActualWidth(), getActualHeight(), getNumChannels());
+      auto r = view.colorize(color);
       releaseMemory();
       return r;
     }
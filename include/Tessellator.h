@@ -0,0 +1,23 @@
+#ifndef _CANVAS_TESSELLATOR_H_
+#define _CANVAS_TESSELLATOR_H_
+
+#include <Path2D.h>
+#include <FillRule.h>
+#include <TriangleMesh.h>
+
+namespace canvas {
+  // Converts flat paths (see Path2D::isFlat) to triangles. Both functions
+  // append to the mesh.
+  class Tessellator {
+  public:
+    // Splits the fill into trapezoids with a sweep, keeping those inside
+    // by the fill rule. A trapezoid ends only where one of its sides does
+    // or another edge enters between them.
+    static void fill(const Path2D & path, FillRule rule, TriangleMesh & mesh);
+    // Quads for the segments and round joins, with butt caps. Triangles
+    // may overlap at joins.
+    static void stroke(const Path2D & path, double line_width, double tolerance, TriangleMesh & mesh);
+  };
+};
+
+#endif
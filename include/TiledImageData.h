@@ -0,0 +1,56 @@
+#ifndef _TILEDIMAGEDATA_H_
+#define _TILEDIMAGEDATA_H_
+
+#include <ImageData.h>
+#include <ImageDataView.h>
+#include <PixelBuffer.h>
+
+#include <memory>
+#include <vector>
+
+namespace canvas {
+  // Image stored as square tiles that are only allocated when written to.
+  // Tiles that have never been written read as zero. scale() and blur()
+  // process one output tile at a time, so their working set is bounded by
+  // the tile size rather than the image size.
+  class TiledImageData {
+  public:
+    TiledImageData(unsigned int _width, unsigned int _height, unsigned short _num_channels, unsigned int _tile_size = 256);
+    TiledImageData(const TiledImageData & other) = delete;
+    TiledImageData & operator=(const TiledImageData & other) = delete;
+
+    unsigned int getWidth() const { return width; }
+    unsigned int getHeight() const { return height; }
+    unsigned short getNumChannels() const { return num_channels; }
+    unsigned int getTileSize() const { return tile_size; }
+    unsigned int getNumTilesX() const { return cols; }
+    unsigned int getNumTilesY() const { return rows; }
+    size_t getNumAllocatedTiles() const;
+
+    bool isTileAllocated(unsigned int tx, unsigned int ty) const { return tiles[ty * cols + tx].get() != 0; }
+    unsigned int getTileWidth(unsigned int tx) const { return tx + 1 < cols ? tile_size : width - tx * tile_size; }
+    unsigned int getTileHeight(unsigned int ty) const { return ty + 1 < rows ? tile_size : height - ty * tile_size; }
+
+    // Returns an empty view for tiles that have not been allocated
+    ImageDataView getTile(unsigned int tx, unsigned int ty) const;
+    // Allocates the tile if needed and returns its first row
+    unsigned char * getTileForWriting(unsigned int tx, unsigned int ty);
+
+    void write(unsigned int x, unsigned int y, const ImageDataView & input);
+    std::unique_ptr<ImageData> read(unsigned int x, unsigned int y, unsigned int w, unsigned int h) const;
+
+    std::unique_ptr<TiledImageData> scale(unsigned int target_width, unsigned int target_height) const;
+    std::unique_ptr<TiledImageData> blur(float hradius, float vradius) const;
+
+  private:
+    std::unique_ptr<TiledImageData> halve() const;
+    bool isRegionEmpty(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1) const;
+
+    unsigned int width, height;
+    unsigned short num_channels;
+    unsigned int tile_size, cols, rows;
+    std::vector<PixelBuffer> tiles;
+  };
+};
+
+#endif
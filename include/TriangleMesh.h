@@ -0,0 +1,20 @@
+#ifndef _CANVAS_TRIANGLEMESH_H_
+#define _CANVAS_TRIANGLEMESH_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace canvas {
+  // Indexed triangles ready for upload: x, y pairs and three indices
+  // per triangle
+  struct TriangleMesh {
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+
+    size_t getNumVertices() const { return vertices.size() / 2; }
+    size_t getNumTriangles() const { return indices.size() / 3; }
+    bool empty() const { return indices.empty(); }
+  };
+};
+
+#endif
@@ -67,6 +67,8 @@ AndroidCache::AndroidCache(JNIEnv * myEnv, jobject _assetManager) {
   pathLineToMethod = myEnv->GetMethodID(pathClass, "lineTo", "(FF)V");
   pathCloseMethod = myEnv->GetMethodID(pathClass, "close", "()V");
   pathArcToMethod = myEnv->GetMethodID(pathClass, "arcTo", "(Landroid/graphics/RectF;FF)V");
+  pathQuadToMethod = myEnv->GetMethodID(pathClass, "quadTo", "(FFFF)V");
+  pathCubicToMethod = myEnv->GetMethodID(pathClass, "cubicTo", "(FFFFFF)V");
   canvasPathDrawMethod = myEnv->GetMethodID(canvasClass, "drawPath", "(Landroid/graphics/Path;Landroid/graphics/Paint;)V");
   rectFConstructor = myEnv->GetMethodID(rectFClass, "<init>", "(FFFF)V");
   rectConstructor = myEnv->GetMethodID(rectClass, "<init>", "(IIII)V");
@@ -255,23 +257,6 @@ AndroidSurface::imageToBitmap(const ImageData & img) {
   return drawableBitmap;
 }
 
-static int android_read(void* cookie, char* buf, int size) {
-  return AAsset_read((AAsset*)cookie, buf, size);
-}
-
-static int android_write(void* cookie, const char* buf, int size) {
-  return EACCES; // can't provide write access to the apk
-}
-
-static fpos_t android_seek(void* cookie, fpos_t offset, int whence) {
-  return AAsset_seek((AAsset*)cookie, offset, whence);
-}
-
-static int android_close(void* cookie) {
-  AAsset_close((AAsset*)cookie);
-  return 0;
-}
-
 class AndroidImage : public Image {
 public:
   AndroidImage(AAssetManager * _asset_manager, float _display_scale)
@@ -285,21 +270,23 @@ public:
 protected:
   void loadFile() override {
     if (asset_manager) {
-      AAsset * asset = AAssetManager_open(asset_manager, getFilename().c_str(), 0);
+      // AASSET_MODE_BUFFER maps uncompressed assets directly from the apk
+      AAsset * asset = AAssetManager_open(asset_manager, getFilename().c_str(), AASSET_MODE_BUFFER);
       if (asset) {
-        FILE * in = funopen(asset, android_read, android_write, android_seek, android_close);
-
-        basic_string<unsigned char> s;
-        while (!feof(in)) {
-          unsigned char b[256];
-          size_t n = fread(b, 1, 256, in);
-          s += basic_string<unsigned char>(b, n);
-        }
-        fclose(in);
+        const unsigned char * buffer = (const unsigned char *)AAsset_getBuffer(asset);
+        size_t size = AAsset_getLength(asset);
 
-        __android_log_print(ANDROID_LOG_VERBOSE, "Sometrik", "image %s loaded successfully: %d", getFilename().c_str(), int(s.size()));
+        __android_log_print(ANDROID_LOG_VERBOSE, "Sometrik", "image %s loaded successfully: %d", getFilename().c_str(), int(size));
 
-        data = loadFromMemory(s.data(), s.size());
+        try {
+          if (buffer) data = loadFromMemory(buffer, size);
+        } catch (...) {
+          AAsset_close(asset);
+          throw;
+        }
+        AAsset_close(asset);
+      }
+      if (data.get()) {
         __android_log_print(ANDROID_LOG_INFO, "Sometrik", "Image Width = %u", data->getWidth());
         __android_log_print(ANDROID_LOG_INFO, "Sometrik", "Image height = %u", data->getHeight());
       }
@@ -310,6 +297,19 @@ protected:
     }
   }
 
+  bool probeFile() override {
+    bool r = false;
+    if (asset_manager) {
+      AAsset * asset = AAssetManager_open(asset_manager, getFilename().c_str(), AASSET_MODE_BUFFER);
+      if (asset) {
+        const unsigned char * buffer = (const unsigned char *)AAsset_getBuffer(asset);
+        r = buffer && probeMemory(buffer, AAsset_getLength(asset), probed_width, probed_height, probed_num_channels);
+        AAsset_close(asset);
+      }
+    }
+    return r;
+  }
+
 private:
   AAssetManager * asset_manager;
 };
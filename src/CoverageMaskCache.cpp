@@ -0,0 +1,96 @@
+#include <CoverageMaskCache.h>
+
+#include <Rasterizer.h>
+
+#include <cmath>
+#include <cstring>
+
+using namespace canvas;
+using namespace std;
+
+namespace {
+  // 64-bit FNV-1a
+  uint64_t hashKey(const vector<int32_t> & key) {
+    uint64_t value = 14695981039346656037ULL;
+    const unsigned char * p = (const unsigned char *)key.data();
+    for (size_t i = 0; i < key.size() * sizeof(int32_t); i++) {
+      value = (value ^ p[i]) * 1099511628211ULL;
+    }
+    return value;
+  }
+
+  int32_t getBits(float v) {
+    int32_t r;
+    memcpy(&r, &v, sizeof(r));
+    return r;
+  }
+
+  int32_t quantize(double v) { return int32_t(lround(v * 255)); }
+};
+
+shared_ptr<const CoverageMask>
+CoverageMaskCache::getMask(const Path2D & path, FillRule rule, const Color & color, float display_scale, int & x, int & y) {
+  double min_x, min_y, max_x, max_y;
+  path.getExtents(min_x, min_y, max_x, max_y);
+  double dx0 = min_x * display_scale, dy0 = min_y * display_scale;
+  double w = (max_x - min_x) * display_scale, h = (max_y - min_y) * display_scale;
+  if (path.empty() || w + 2 > max_mask_size || h + 2 > max_mask_size) {
+    return shared_ptr<const CoverageMask>();
+  }
+  
+  x = int(floor(dx0));
+  y = int(floor(dy0));
+  int bx = int((dx0 - x) * subpixel_steps), by = int((dy0 - y) * subpixel_steps);
+  if (bx >= int(subpixel_steps)) bx = subpixel_steps - 1;
+  if (by >= int(subpixel_steps)) by = subpixel_steps - 1;
+
+  // coordinates relative to the bounds at 1/64 device pixel, so that
+  // float noise from the translation doesn't change the key
+  auto & verbs = path.getVerbs();
+  auto & points = path.getPoints();
+  auto & arcs = path.getArcs();
+  vector<int32_t> key;
+  key.reserve(12 + verbs.size() + points.size() + 6 * arcs.size());
+  key.push_back(int32_t(rule));
+  key.push_back(getBits(display_scale));
+  key.push_back(bx);
+  key.push_back(by);
+  key.push_back(quantize(color.red));
+  key.push_back(quantize(color.green));
+  key.push_back(quantize(color.blue));
+  key.push_back(quantize(color.alpha));
+  key.push_back(int32_t(verbs.size()));
+  key.push_back(int32_t(points.size()));
+  key.push_back(int32_t(arcs.size()));
+  for (auto v : verbs) key.push_back(v);
+  for (size_t i = 0; i < points.size(); i += 2) {
+    key.push_back(int32_t(lround((points[i] * display_scale - dx0) * 64)));
+    key.push_back(int32_t(lround((points[i + 1] * display_scale - dy0) * 64)));
+  }
+  for (auto & a : arcs) {
+    key.push_back(int32_t(lround(a.radius * display_scale * 64)));
+    key.push_back(int32_t(lround(a.radius_y * display_scale * 64)));
+    key.push_back(getBits(float(a.rotation)));
+    key.push_back(getBits(float(a.sa)));
+    key.push_back(getBits(float(a.ea)));
+    key.push_back(a.anticlockwise);
+  }
+  uint64_t h64 = hashKey(key);
+
+  auto mask = cache.get(h64);
+  // a hash collision is treated as a miss and replaces the entry
+  if (!mask || mask->key != key) {
+    // place the bounds at the center of the subpixel bucket
+    double ox = (bx + 0.5) / subpixel_steps, oy = (by + 0.5) / subpixel_steps;
+    unsigned int mw = (unsigned int)ceil(w + ox) + 1, mh = (unsigned int)ceil(h + oy) + 1;
+    mask = make_shared<CoverageMask>(mw, mh);
+    Rasterizer rasterizer;
+    rasterizer.setPath(path, display_scale, ox - dx0, oy - dy0);
+    rasterizer.fill(mask->mask.getData(), mw, mh, mw, rule);
+    mask->image = mask->mask.colorize(color);
+    mask->key = std::move(key);
+    // one byte of coverage and four of color per pixel
+    cache.put(h64, mask, size_t(mw) * mh * 5);
+  }
+  return mask;
+}
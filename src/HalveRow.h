@@ -0,0 +1,85 @@
+#ifndef _HALVEROW_H_
+#define _HALVEROW_H_
+
+#if defined __SSE2__ || defined _M_X64
+#include <emmintrin.h>
+#define CANVAS_HALVE_SSE2
+#elif defined __ARM_NEON || defined __ARM_NEON__
+#include <arm_neon.h>
+#define CANVAS_HALVE_NEON
+#endif
+
+namespace canvas {
+  // Writes the rounded 2x2 box average of two input rows. width is the
+  // output width; the inputs must hold 2 * width pixels. out may alias
+  // row0 since each output byte is written after its inputs are read.
+  static inline void halveRow(const unsigned char * row0, const unsigned char * row1, unsigned int width, unsigned int num_channels, unsigned char * out) {
+    unsigned int x = 0;
+    if (num_channels == 4) {
+      // four output pixels from 32 bytes of each row
+#if defined CANVAS_HALVE_SSE2
+      const __m128i zero = _mm_setzero_si128(), two = _mm_set1_epi16(2);
+      for (; x + 4 <= width; x += 4) {
+	__m128i a0 = _mm_loadu_si128((const __m128i *)(row0 + 8 * x));
+	__m128i a1 = _mm_loadu_si128((const __m128i *)(row0 + 8 * x + 16));
+	__m128i b0 = _mm_loadu_si128((const __m128i *)(row1 + 8 * x));
+	__m128i b1 = _mm_loadu_si128((const __m128i *)(row1 + 8 * x + 16));
+	__m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+	__m128i s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+	__m128i s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+	__m128i s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+	// each 128-bit sum holds two neighbouring pixels in its halves
+	__m128i p0 = _mm_add_epi16(_mm_unpacklo_epi64(s0, s1), _mm_unpackhi_epi64(s0, s1));
+	__m128i p1 = _mm_add_epi16(_mm_unpacklo_epi64(s2, s3), _mm_unpackhi_epi64(s2, s3));
+	p0 = _mm_srli_epi16(_mm_add_epi16(p0, two), 2);
+	p1 = _mm_srli_epi16(_mm_add_epi16(p1, two), 2);
+	_mm_storeu_si128((__m128i *)(out + 4 * x), _mm_packus_epi16(p0, p1));
+      }
+#elif defined CANVAS_HALVE_NEON
+      for (; x + 4 <= width; x += 4) {
+	uint8x16_t a0 = vld1q_u8(row0 + 8 * x), a1 = vld1q_u8(row0 + 8 * x + 16);
+	uint8x16_t b0 = vld1q_u8(row1 + 8 * x), b1 = vld1q_u8(row1 + 8 * x + 16);
+	uint16x8_t s0 = vaddl_u8(vget_low_u8(a0), vget_low_u8(b0));
+	uint16x8_t s1 = vaddl_u8(vget_high_u8(a0), vget_high_u8(b0));
+	uint16x8_t s2 = vaddl_u8(vget_low_u8(a1), vget_low_u8(b1));
+	uint16x8_t s3 = vaddl_u8(vget_high_u8(a1), vget_high_u8(b1));
+	uint16x8_t p0 = vcombine_u16(vadd_u16(vget_low_u16(s0), vget_high_u16(s0)), vadd_u16(vget_low_u16(s1), vget_high_u16(s1)));
+	uint16x8_t p1 = vcombine_u16(vadd_u16(vget_low_u16(s2), vget_high_u16(s2)), vadd_u16(vget_low_u16(s3), vget_high_u16(s3)));
+	vst1q_u8(out + 4 * x, vcombine_u8(vrshrn_n_u16(p0, 2), vrshrn_n_u16(p1, 2)));
+      }
+#endif
+    }
+    row0 += 2 * x * num_channels;
+    row1 += 2 * x * num_channels;
+    out += x * num_channels;
+    for (; x < width; x++) {
+      for (unsigned int c = 0; c < num_channels; c++) {
+	out[c] = (unsigned char)((row0[c] + row0[num_channels + c] + row1[c] + row1[num_channels + c] + 2) >> 2);
+      }
+      row0 += 2 * num_channels;
+      row1 += 2 * num_channels;
+      out += num_channels;
+    }
+  }
+
+  // Halves a width x height image into (width + 1) / 2 x (height + 1) / 2
+  // pixels; an odd last row or column is averaged on its own. out may
+  // alias in, since each output row is written after its inputs are read.
+  static inline void halveImage(const unsigned char * in, unsigned int width, unsigned int height, unsigned int num_channels, unsigned char * out) {
+    unsigned int w2 = (width + 1) / 2, h2 = (height + 1) / 2;
+    size_t row_size = size_t(width) * num_channels;
+    for (unsigned int y = 0; y < h2; y++) {
+      const unsigned char * row0 = in + 2 * y * row_size;
+      const unsigned char * row1 = 2 * y + 1 < height ? row0 + row_size : row0;
+      unsigned char * out_row = out + size_t(y) * w2 * num_channels;
+      halveRow(row0, row1, width / 2, num_channels, out_row);
+      if (width & 1) {
+	for (unsigned int c = 0; c < num_channels; c++) {
+	  out_row[(w2 - 1) * num_channels + c] = (unsigned char)((row0[(width - 1) * num_channels + c] + row1[(width - 1) * num_channels + c] + 1) >> 1);
+	}
+      }
+    }
+  }
+};
+
+#endif
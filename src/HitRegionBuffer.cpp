@@ -0,0 +1,27 @@
+#include <HitRegionBuffer.h>
+
+#include <Rasterizer.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace canvas;
+
+void
+HitRegionBuffer::addRegion(unsigned int _width, unsigned int _height, unsigned int id, const Path2D & path, FillRule rule) {
+  if (!isAllocated()) {
+    if (!_width || !_height) return;
+    width = _width;
+    height = _height;
+    size_t size = size_t(width) * height * sizeof(unsigned int);
+    buffer = allocatePixelBuffer(size);
+    memset(buffer.get(), 0, size);
+  }
+  
+  Rasterizer rasterizer;
+  rasterizer.setPath(path);
+  unsigned int * ids = getIds();
+  rasterizer.getSpans(width, height, rule, [&](unsigned int y, unsigned int x0, unsigned int x1) {
+      std::fill(ids + size_t(y) * width + x0, ids + size_t(y) * width + x1, id);
+    });
+}
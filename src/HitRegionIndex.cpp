@@ -0,0 +1,29 @@
+#include <HitRegionIndex.h>
+
+#include <cmath>
+#include <climits>
+
+using namespace canvas;
+
+int
+HitRegionIndex::getCell(double v) const {
+  double c = floor(v / cell_size);
+  if (c < INT_MIN) return INT_MIN;
+  if (c > INT_MAX) return INT_MAX;
+  return int(c);
+}
+
+void
+HitRegionIndex::insert(size_t index, double min_x, double min_y, double max_x, double max_y) {
+  int cx0 = getCell(min_x), cy0 = getCell(min_y), cx1 = getCell(max_x), cy1 = getCell(max_y);
+  double num_cells = (double(cx1) - cx0 + 1) * (double(cy1) - cy0 + 1);
+  if (num_cells > max_cells_per_region) {
+    large_regions.push_back(index);
+    return;
+  }
+  for (int cy = cy0; cy <= cy1; cy++) {
+    for (int cx = cx0; cx <= cx1; cx++) {
+      cells[getKey(cx, cy)].push_back(index);
+    }
+  }
+}
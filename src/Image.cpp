@@ -1,6 +1,8 @@
 #include <Image.h>
 
 #include <ImageLoadingException.h>
+#include <ImageDecodePool.h>
+#include <MappedFile.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -15,8 +17,51 @@ Image::decode(const unsigned char * buffer, size_t size) {
   data = loadFromMemory(buffer, size);
 }
 
+static PixelBuffer
+adoptDecoderOutput(stbi_uc * buffer) {
+  return PixelBuffer(buffer, [](unsigned char * p) { stbi_image_free(p); });
+}
+
+void
+Image::loadAsync(const std::shared_ptr<Image> & image, ImageDecodePool & pool, int priority, std::function<void(const std::shared_ptr<ImageData> &)> callback) {
+  assert(image.get());
+  if (image->filename.empty() || image->data.get()) {
+    if (callback) callback(image->data);
+    return;
+  }
+  auto promise = std::make_shared<std::promise<void> >();
+  image->pending_load = promise->get_future().share();
+  std::weak_ptr<Image> weak_image = image;
+  pool.enqueue(priority, [weak_image, promise, callback]() {
+      auto image = weak_image.lock();
+      if (!image) return;
+      std::shared_ptr<ImageData> data;
+      try {
+	image->loadFile();
+	// the owner may replace the data as soon as the promise is fulfilled
+	data = image->data;
+      } catch (...) {
+	promise->set_exception(std::current_exception());
+	return;
+      }
+      promise->set_value();
+      if (callback) callback(data);
+    });
+}
+
+// Only the formats sniffed here are passed to the decoder
+static bool isSupported(const unsigned char * buffer, size_t size) {
+  return Image::isPNG(buffer, size) || Image::isJPEG(buffer, size) || Image::isGIF(buffer, size) || Image::isBMP(buffer, size);
+}
+
 std::unique_ptr<ImageData>
 Image::loadFromMemory(const unsigned char * buffer, size_t size) {
+  if (isXML(buffer, size)) {
+    throw ImageLoadingException("XML images are not supported");
+  }
+  if (!isSupported(buffer, size)) {
+    throw ImageLoadingException("unknown image format");
+  }
   int w, h, channels;
   auto img_buffer = stbi_load_from_memory(buffer, size, &w, &h, &channels, 0);
   if (!img_buffer) {
@@ -25,28 +70,37 @@ Image::loadFromMemory(const unsigned char * buffer, size_t size) {
   // cerr << "Image.cpp: loaded image, size = " << size << ", b = " << (void*)img_buffer << ", w = " << w << ", h = " << h << ", ch = " << channels << endl;
   assert(w && h && channels);    
 
-  std::unique_ptr<ImageData> data = std::unique_ptr<ImageData>(new ImageData((unsigned char *)img_buffer, w, h, channels));
-  
-  stbi_image_free(img_buffer);
-  
-  return data;
+  return std::unique_ptr<ImageData>(new ImageData(adoptDecoderOutput(img_buffer), w, h, channels));
 }
 
 std::unique_ptr<ImageData>
 Image::loadFromFile(const std::string & filename) {
   assert(!filename.empty());
-  int w, h, channels;
-  auto img_buffer = stbi_load(filename.c_str(), &w, &h, &channels, 0);
-  if (!img_buffer) {
-    throw ImageLoadingException(stbi_failure_reason());
+  MappedFile file(filename);
+  if (!file.isValid()) {
+    throw ImageLoadingException("can't open file");
   }
-  assert(w && h && channels);    
+  file.adviseSequential();
+  return loadFromMemory(file.getData(), file.getSize());
+}
 
-  std::unique_ptr<ImageData> data = std::unique_ptr<ImageData>(new ImageData((unsigned char *)img_buffer, w, h, channels));
-  
-  stbi_image_free(img_buffer);
+bool
+Image::probeMemory(const unsigned char * buffer, size_t size, unsigned int & width, unsigned int & height, unsigned int & num_channels) {
+  int w, h, channels;
+  if (!isSupported(buffer, size) || !stbi_info_from_memory(buffer, size, &w, &h, &channels)) {
+    return false;
+  }
+  width = w;
+  height = h;
+  num_channels = channels;
+  return true;
+}
 
-  return data;
+bool
+Image::probeFile() {
+  // only the pages holding the header are read from the mapping
+  MappedFile file(filename);
+  return file.isValid() && probeMemory(file.getData(), file.getSize(), probed_width, probed_height, probed_num_channels);
 }
 
 bool
@@ -1,183 +1,130 @@
 #include <ImageData.h>
+#include <ImageDataView.h>
+
+#include "HalveRow.h"
 
 #include <vector>
+#include <cmath>
 #include <cassert>
 
-#define STB_IMAGE_RESIZE_IMPLEMENTATION
-#include "stb_image_resize.h"
-
 using namespace std;
 using namespace canvas;
 
 ImageData ImageData::nullImage;
 
-std::unique_ptr<ImageData>
-ImageData::scale(unsigned short target_width, unsigned short target_height) const {
-  size_t target_size = calculateSize(target_width, target_height, num_channels);
-
-  std::unique_ptr<unsigned char[]> output_data(new unsigned char[target_size]);
-
-  stbir_resize_uint8(data.get(), getWidth(), getHeight(), 0, output_data.get(), target_width, target_height, 0, num_channels);
+ImageData::ImageData(const ImageDataView & view)
+  : width(view.getWidth()), height(view.getHeight()), num_channels(view.getNumChannels())
+{
+  size_t row_size = size_t(width) * num_channels;
+  data = allocatePixelBuffer(calculateSize());
+  for (unsigned int y = 0; y < height; y++) {
+    memcpy(data.get() + y * row_size, view.getRow(y), row_size);
+  }
+}
 
-  return unique_ptr<ImageData>(new ImageData(output_data.get(), target_width, target_height, num_channels));
+std::unique_ptr<ImageData>
+ImageData::scale(unsigned int target_width, unsigned int target_height, const ResizeOptions & options) const {
+  return ImageDataView(*this).scale(target_width, target_height, options);
 }
 
 std::unique_ptr<ImageData>
 ImageData::colorize(const Color & color) const {
-  assert(num_channels == 1);
-
-  int red = int(255 * color.red * color.alpha);
-  int green = int(255 * color.green * color.alpha);
-  int blue = int(255 * color.blue * color.alpha);
-  int alpha = int(255 * color.alpha);
-
-  unique_ptr<ImageData> r(new ImageData(width, height, 4));
-
-  unsigned char * target_buffer = r->getData();
-  for (unsigned int i = 0; i < width * height; i++) {
-    unsigned char v = data[i];
-    target_buffer[4 * i + 0] = (unsigned char)(red * v / 255);
-    target_buffer[4 * i + 1] = (unsigned char)(green * v / 255);
-    target_buffer[4 * i + 2] = (unsigned char)(blue * v / 255);
-    target_buffer[4 * i + 3] = (unsigned char)(alpha * v / 255);
-  }
+  return ImageDataView(*this).colorize(color);
+}
 
-  return r;
+std::unique_ptr<ImageData>
+ImageData::blur(float hradius, float vradius) const {
+  return ImageDataView(*this).blur(hradius, vradius);
 }
 
-static vector<int> make_kernel(float radius) {
-  int r = (int)ceil(radius);
-  int rows = 2 * r + 1;
-  float sigma = radius / 3;
-  float sigma22 = 2.0f * sigma * sigma;
-  float sigmaPi2 = 2.0f * float(M_PI) * sigma;
-  float sqrtSigmaPi2 = sqrt(sigmaPi2);
-  // float radius2 = radius*radius;
-  vector<int> kernel;
-  kernel.reserve(rows);
-
-  int row = -r;
-  float first_value = exp(-row*row/sigma22) / sqrtSigmaPi2;
-  kernel.push_back(1);
-
-  for (unsigned int i = 1; i < rows; i++, row++) {
-    // for (row++; row <= r; row++) {
-    kernel.push_back(int(exp(-row * row / sigma22) / sqrtSigmaPi2 / first_value));
+void
+ImageData::reduce(unsigned int target_width, unsigned int target_height) {
+  unsigned char * ptr = data.get();
+  if (!ptr || !target_width || !target_height) return;
+  size_t original_size = calculateSize();
+  while (width >= 2 * target_width && height >= 2 * target_height && width >= 2 && height >= 2) {
+    halveImage(ptr, width, height, num_channels, ptr);
+    width = (width + 1) / 2;
+    height = (height + 1) / 2;
+  }
+  // release the full size allocation so that cache budgets see the real size
+  size_t s = calculateSize();
+  if (s < original_size) {
+    PixelBuffer reduced = allocatePixelBuffer(s);
+    memcpy(reduced.get(), ptr, s);
+    data = std::move(reduced);
   }
-  return kernel;
 }
 
-std::unique_ptr<ImageData>
-ImageData::blur(float hradius, float vradius) const {
-  unique_ptr<ImageData> r(new ImageData(width, height, num_channels));
-
-  if (num_channels == 4) {
-    unsigned char * tmp = new unsigned char[width * height * 4];
-    if (hradius > 0.0f) {
-      vector<int> hkernel = make_kernel(hradius);
-      unsigned short hsize = hkernel.size();
-
-      int htotal = 0;
-      for (auto & a : hkernel) htotal += a;
-
-      memset(tmp, 0, width * height * 4);
-      for (unsigned int row = 0; row < height; row++) {
-        for (unsigned int col = 0; col + hsize <= width; col++) {
-          int c0 = 0, c1 = 0, c2 = 0, c3 = 0;
-          for (unsigned int i = 0; i < hsize; i++) {
-            const unsigned char * ptr = getData() + (row * width + col + i) * 4;
-            c0 += *ptr++ * hkernel[i];
-            c1 += *ptr++ * hkernel[i];
-            c2 += *ptr++ * hkernel[i];
-            c3 += *ptr++ * hkernel[i];
-          }
-          unsigned char * ptr = tmp + (row * width + col + hsize / 2) * 4;
-          *ptr++ = (unsigned char)(c0 / htotal);
-          *ptr++ = (unsigned char)(c1 / htotal);
-          *ptr++ = (unsigned char)(c2 / htotal);
-          *ptr++ = (unsigned char)(c3 / htotal);
-        }
-      }
-    } else {
-      memcpy(tmp, getData(), width * height * 4);
-    }
-    if (vradius > 0) {
-      vector<int> vkernel = make_kernel(vradius);
-      unsigned short vsize = vkernel.size();
-
-      int vtotal = 0;
-      for (auto & a : vkernel) vtotal += a;
-
-      memset(r->getData(), 0, width * height * 4);
-      for (unsigned int col = 0; col < width; col++) {
-        for (unsigned int row = 0; row + vsize <= height; row++) {
-          int c0 = 0, c1 = 0, c2 = 0, c3 = 0;
-          for (unsigned int i = 0; i < vsize; i++) {
-            const unsigned char * ptr = tmp + ((row + i) * width + col) * 4;
-            c0 += *ptr++ * vkernel[i];
-            c1 += *ptr++ * vkernel[i];
-            c2 += *ptr++ * vkernel[i];
-            c3 += *ptr++ * vkernel[i];
-          }
-          unsigned char * ptr = r->getData() + ((row + vsize / 2) * width + col) * 4;
-          *ptr++ = (unsigned char)(c0 / vtotal);
-          *ptr++ = (unsigned char)(c1 / vtotal);
-          *ptr++ = (unsigned char)(c2 / vtotal);
-          *ptr++ = (unsigned char)(c3 / vtotal);
-        }
-      }
-    } else {
-      memcpy(r->getData(), tmp, width * height * 4);
-    }
-    delete[] tmp;
-  } else if (num_channels == 1) {
-    unsigned char * tmp = new unsigned char[width * height];
-    if (hradius > 0.0f) {
-      vector<int> hkernel = make_kernel(hradius);
-      unsigned short hsize = hkernel.size();
-
-      int htotal = 0;
-      for (auto & a : hkernel) htotal += a;
-
-      memset(tmp, 0, width * height);
-      for (unsigned int row = 0; row < height; row++) {
-        for (unsigned int col = 0; col + hsize <= width; col++) {
-          int c0 = 0;
-          for (unsigned int i = 0; i < hsize; i++) {
-            const unsigned char * ptr = getData() + (row * width + col + i);
-            c0 += *ptr * hkernel[i];
-          }
-          unsigned char * ptr = tmp + (row * width + col + hsize / 2);
-          *ptr = (unsigned char)(c0 / htotal);
-        }
-      }
-    } else {
-      memcpy(tmp, getData(), width * height);
+static inline void get_rgba(const unsigned char * p, unsigned short num_channels, unsigned int * rgba) {
+  switch (num_channels) {
+  case 1: rgba[0] = rgba[1] = rgba[2] = p[0]; rgba[3] = 0xff; break;
+  case 2: rgba[0] = rgba[1] = rgba[2] = p[0]; rgba[3] = p[1]; break;
+  case 3: rgba[0] = p[0]; rgba[1] = p[1]; rgba[2] = p[2]; rgba[3] = 0xff; break;
+  default: rgba[0] = p[0]; rgba[1] = p[1]; rgba[2] = p[2]; rgba[3] = p[3]; break;
+  }
+}
+
+// Images with different channel counts are compared as RGBA, with gray
+// replicated to RGB and missing alpha treated as opaque.
+double
+ImageData::calculatePSNR(const ImageData & other, bool include_alpha) const {
+  assert(width == other.width && height == other.height);
+  if (width != other.width || height != other.height || !width || !height) return 0.0;
+
+  const unsigned char * a = getData(), * b = other.getData();
+  unsigned int channels = include_alpha ? 4 : 3;
+  double sum = 0.0;
+  for (size_t i = 0; i < size_t(width) * height; i++, a += num_channels, b += other.num_channels) {
+    unsigned int va[4], vb[4];
+    get_rgba(a, num_channels, va);
+    get_rgba(b, other.num_channels, vb);
+    for (unsigned int c = 0; c < channels; c++) {
+      int d = int(va[c]) - int(vb[c]);
+      sum += d * d;
     }
-    if (vradius > 0) {
-      vector<int> vkernel = make_kernel(vradius);
-      unsigned short vsize = vkernel.size();
-      int vtotal = 0;
-      for (auto & a : vkernel) vtotal += a;
-
-      memset(r->getData(), 0, width * height);
-      for (unsigned int col = 0; col < width; col++) {
-        for (unsigned int row = 0; row + vsize <= height; row++) {
-          int c0 = 0;
-          for (unsigned int i = 0; i < vsize; i++) {
-            const unsigned char * ptr = tmp + ((row + i) * width + col);
-            c0 += *ptr * vkernel[i];
-          }
-          unsigned char * ptr = r->getData() + ((row + vsize / 2) * width + col);
-          *ptr = (unsigned char)(c0 / vtotal);
-        }
+  }
+  double mse = sum / (double(channels) * width * height);
+  if (mse == 0.0) return INFINITY;
+  return 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+static inline double get_luma(const unsigned char * p, unsigned short num_channels) {
+  unsigned int rgba[4];
+  get_rgba(p, num_channels, rgba);
+  return 0.299 * rgba[0] + 0.587 * rgba[1] + 0.114 * rgba[2];
+}
+
+// Mean structural similarity of the luma channel over 8x8 windows
+double
+ImageData::calculateSSIM(const ImageData & other) const {
+  assert(width == other.width && height == other.height);
+  if (width != other.width || height != other.height || !width || !height) return 0.0;
+
+  const double c1 = (0.01 * 255) * (0.01 * 255), c2 = (0.03 * 255) * (0.03 * 255);
+  double total = 0.0;
+  unsigned int windows = 0;
+  for (unsigned int y0 = 0; y0 < height; y0 += 8) {
+    for (unsigned int x0 = 0; x0 < width; x0 += 8) {
+      double sa = 0, sb = 0, saa = 0, sbb = 0, sab = 0;
+      unsigned int n = 0;
+      for (unsigned int y = y0; y < y0 + 8 && y < height; y++) {
+	for (unsigned int x = x0; x < x0 + 8 && x < width; x++, n++) {
+	  double a = get_luma(getData() + (size_t(y) * width + x) * num_channels, num_channels);
+	  double b = get_luma(other.getData() + (size_t(y) * width + x) * other.num_channels, other.num_channels);
+	  sa += a;
+	  sb += b;
+	  saa += a * a;
+	  sbb += b * b;
+	  sab += a * b;
+	}
       }
-    } else {
-      memcpy(r->getData(), tmp, width * height);
+      double ma = sa / n, mb = sb / n;
+      double va = saa / n - ma * ma, vb = sbb / n - mb * mb, cov = sab / n - ma * mb;
+      total += ((2 * ma * mb + c1) * (2 * cov + c2)) / ((ma * ma + mb * mb + c1) * (va + vb + c2));
+      windows++;
     }
-    delete[] tmp;
   }
-
-  return r;
+  return total / windows;
 }
 
@@ -0,0 +1,250 @@
+#include <ImageDataView.h>
+#include <ParallelFor.h>
+
+#include "HalveRow.h"
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include "stb_image_resize.h"
+
+using namespace std;
+using namespace canvas;
+
+static std::unique_ptr<ImageData> halve(const ImageDataView & input) {
+  unsigned int w = input.getWidth() / 2, h = input.getHeight() / 2, num_channels = input.getNumChannels();
+  unique_ptr<ImageData> r(new ImageData(w, h, num_channels, false));
+  unsigned char * output = r->getData();
+  parallelFor(h, 65536 / (w * num_channels + 1) + 1, [&](unsigned int y0, unsigned int y1) {
+      for (unsigned int y = y0; y < y1; y++) {
+	halveRow(input.getRow(2 * y), input.getRow(2 * y + 1), w, num_channels, output + size_t(y) * w * num_channels);
+      }
+    });
+  return r;
+}
+
+static stbir_filter getFilter(ResizeFilter filter) {
+  switch (filter) {
+  case RESIZE_FILTER_BOX: return STBIR_FILTER_BOX;
+  case RESIZE_FILTER_TRIANGLE: return STBIR_FILTER_TRIANGLE;
+  case RESIZE_FILTER_CUBIC_BSPLINE: return STBIR_FILTER_CUBICBSPLINE;
+  case RESIZE_FILTER_CATMULL_ROM: return STBIR_FILTER_CATMULLROM;
+  case RESIZE_FILTER_MITCHELL: return STBIR_FILTER_MITCHELL;
+  default: return STBIR_FILTER_DEFAULT;
+  }
+}
+
+static stbir_edge getEdgeMode(ResizeEdgeMode mode) {
+  switch (mode) {
+  case RESIZE_EDGE_REFLECT: return STBIR_EDGE_REFLECT;
+  case RESIZE_EDGE_WRAP: return STBIR_EDGE_WRAP;
+  case RESIZE_EDGE_ZERO: return STBIR_EDGE_ZERO;
+  default: return STBIR_EDGE_CLAMP;
+  }
+}
+
+std::unique_ptr<ImageData>
+ImageDataView::scale(unsigned int target_width, unsigned int target_height, const ResizeOptions & options) const {
+  bool is_box = options.filter == RESIZE_FILTER_DEFAULT || options.filter == RESIZE_FILTER_BOX;
+  bool has_alpha = num_channels == 2 || num_channels == 4;
+  if (is_box && !options.srgb && (options.premultiplied_alpha || !has_alpha) && target_width && target_height) {
+    if (2 * target_width == width && 2 * target_height == height) {
+      return halve(*this);
+    } else if (4 * target_width == width && 4 * target_height == height) {
+      return halve(*halve(*this));
+    }
+  }
+
+  size_t target_size = ImageData::calculateSize(target_width, target_height, num_channels);
+  PixelBuffer output_data = allocatePixelBuffer(target_size);
+  unsigned char * output = output_data.get();
+
+  int alpha_channel = has_alpha ? num_channels - 1 : STBIR_ALPHA_CHANNEL_NONE;
+  int flags = options.premultiplied_alpha ? STBIR_FLAG_ALPHA_PREMULTIPLIED : 0;
+  stbir_filter filter = getFilter(options.filter);
+  stbir_edge edge_mode = getEdgeMode(options.edge_mode);
+  stbir_colorspace colorspace = options.srgb ? STBIR_COLORSPACE_SRGB : STBIR_COLORSPACE_LINEAR;
+  float sx = float(target_width) / width, sy = float(target_height) / height;
+  size_t output_stride = size_t(target_width) * num_channels;
+
+  // each strip is resampled as a vertically shifted window of the full output
+  parallelFor(target_height, 65536 / (output_stride + 1) + 8, [&](unsigned int y0, unsigned int y1) {
+      stbir_resize_subpixel(data, width, height, (int)stride,
+			    output + y0 * output_stride, target_width, y1 - y0, (int)output_stride,
+			    STBIR_TYPE_UINT8, num_channels, alpha_channel, flags,
+			    edge_mode, edge_mode, filter, filter, colorspace, NULL,
+			    sx, sy, 0.0f, float(y0));
+    });
+
+  return unique_ptr<ImageData>(new ImageData(std::move(output_data), target_width, target_height, num_channels));
+}
+
+std::unique_ptr<ImageData>
+ImageDataView::colorize(const Color & color) const {
+  assert(num_channels == 1);
+
+  int red = int(255 * color.red * color.alpha);
+  int green = int(255 * color.green * color.alpha);
+  int blue = int(255 * color.blue * color.alpha);
+  int alpha = int(255 * color.alpha);
+
+  unique_ptr<ImageData> r(new ImageData(width, height, 4, false));
+
+  unsigned char * target_buffer = r->getData();
+  for (unsigned int y = 0; y < height; y++) {
+    const unsigned char * row = getRow(y);
+    for (unsigned int x = 0; x < width; x++, target_buffer += 4) {
+      unsigned char v = row[x];
+      target_buffer[0] = (unsigned char)(red * v / 255);
+      target_buffer[1] = (unsigned char)(green * v / 255);
+      target_buffer[2] = (unsigned char)(blue * v / 255);
+      target_buffer[3] = (unsigned char)(alpha * v / 255);
+    }
+  }
+
+  return r;
+}
+
+static vector<int> make_kernel(float radius) {
+  int r = (int)ceil(radius);
+  int rows = 2 * r + 1;
+  float sigma = radius / 3;
+  float sigma22 = 2.0f * sigma * sigma;
+  float sigmaPi2 = 2.0f * float(M_PI) * sigma;
+  float sqrtSigmaPi2 = sqrt(sigmaPi2);
+  // float radius2 = radius*radius;
+  vector<int> kernel;
+  kernel.reserve(rows);
+
+  int row = -r;
+  float first_value = exp(-row*row/sigma22) / sqrtSigmaPi2;
+  kernel.push_back(1);
+
+  for (unsigned int i = 1; i < rows; i++, row++) {
+    // for (row++; row <= r; row++) {
+    kernel.push_back(int(exp(-row * row / sigma22) / sqrtSigmaPi2 / first_value));
+  }
+  return kernel;
+}
+
+std::unique_ptr<ImageData>
+ImageDataView::blur(float hradius, float vradius) const {
+  // the 1 and 4 channel paths write every output pixel
+  unique_ptr<ImageData> r(new ImageData(width, height, num_channels, num_channels != 1 && num_channels != 4));
+
+  if (num_channels == 4) {
+    PixelBuffer tmp_buffer = allocatePixelBuffer(size_t(width) * height * 4);
+    unsigned char * tmp = tmp_buffer.get();
+    if (hradius > 0.0f) {
+      vector<int> hkernel = make_kernel(hradius);
+      unsigned short hsize = hkernel.size();
+
+      int htotal = 0;
+      for (auto & a : hkernel) htotal += a;
+
+      memset(tmp, 0, size_t(width) * height * 4);
+      for (unsigned int row = 0; row < height; row++) {
+	const unsigned char * input_row = getRow(row);
+        for (unsigned int col = 0; col + hsize <= width; col++) {
+          int c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+          for (unsigned int i = 0; i < hsize; i++) {
+            const unsigned char * ptr = input_row + (col + i) * 4;
+            c0 += *ptr++ * hkernel[i];
+            c1 += *ptr++ * hkernel[i];
+            c2 += *ptr++ * hkernel[i];
+            c3 += *ptr++ * hkernel[i];
+          }
+          unsigned char * ptr = tmp + (size_t(row) * width + col + hsize / 2) * 4;
+          *ptr++ = (unsigned char)(c0 / htotal);
+          *ptr++ = (unsigned char)(c1 / htotal);
+          *ptr++ = (unsigned char)(c2 / htotal);
+          *ptr++ = (unsigned char)(c3 / htotal);
+        }
+      }
+    } else {
+      for (unsigned int row = 0; row < height; row++) {
+	memcpy(tmp + size_t(row) * width * 4, getRow(row), width * 4);
+      }
+    }
+    if (vradius > 0) {
+      vector<int> vkernel = make_kernel(vradius);
+      unsigned short vsize = vkernel.size();
+
+      int vtotal = 0;
+      for (auto & a : vkernel) vtotal += a;
+
+      memset(r->getData(), 0, size_t(width) * height * 4);
+      for (unsigned int col = 0; col < width; col++) {
+        for (unsigned int row = 0; row + vsize <= height; row++) {
+          int c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+          for (unsigned int i = 0; i < vsize; i++) {
+            const unsigned char * ptr = tmp + ((size_t(row) + i) * width + col) * 4;
+            c0 += *ptr++ * vkernel[i];
+            c1 += *ptr++ * vkernel[i];
+            c2 += *ptr++ * vkernel[i];
+            c3 += *ptr++ * vkernel[i];
+          }
+          unsigned char * ptr = r->getData() + ((size_t(row) + vsize / 2) * width + col) * 4;
+          *ptr++ = (unsigned char)(c0 / vtotal);
+          *ptr++ = (unsigned char)(c1 / vtotal);
+          *ptr++ = (unsigned char)(c2 / vtotal);
+          *ptr++ = (unsigned char)(c3 / vtotal);
+        }
+      }
+    } else {
+      memcpy(r->getData(), tmp, size_t(width) * height * 4);
+    }
+  } else if (num_channels == 1) {
+    PixelBuffer tmp_buffer = allocatePixelBuffer(size_t(width) * height);
+    unsigned char * tmp = tmp_buffer.get();
+    if (hradius > 0.0f) {
+      vector<int> hkernel = make_kernel(hradius);
+      unsigned short hsize = hkernel.size();
+
+      int htotal = 0;
+      for (auto & a : hkernel) htotal += a;
+
+      memset(tmp, 0, size_t(width) * height);
+      for (unsigned int row = 0; row < height; row++) {
+	const unsigned char * input_row = getRow(row);
+        for (unsigned int col = 0; col + hsize <= width; col++) {
+          int c0 = 0;
+          for (unsigned int i = 0; i < hsize; i++) {
+            c0 += input_row[col + i] * hkernel[i];
+          }
+          unsigned char * ptr = tmp + (size_t(row) * width + col + hsize / 2);
+          *ptr = (unsigned char)(c0 / htotal);
+        }
+      }
+    } else {
+      for (unsigned int row = 0; row < height; row++) {
+	memcpy(tmp + size_t(row) * width, getRow(row), width);
+      }
+    }
+    if (vradius > 0) {
+      vector<int> vkernel = make_kernel(vradius);
+      unsigned short vsize = vkernel.size();
+      int vtotal = 0;
+      for (auto & a : vkernel) vtotal += a;
+
+      memset(r->getData(), 0, size_t(width) * height);
+      for (unsigned int col = 0; col < width; col++) {
+        for (unsigned int row = 0; row + vsize <= height; row++) {
+          int c0 = 0;
+          for (unsigned int i = 0; i < vsize; i++) {
+            const unsigned char * ptr = tmp + ((size_t(row) + i) * width + col);
+            c0 += *ptr * vkernel[i];
+          }
+          unsigned char * ptr = r->getData() + ((size_t(row) + vsize / 2) * width + col);
+          *ptr = (unsigned char)(c0 / vtotal);
+        }
+      }
+    } else {
+      memcpy(r->getData(), tmp, size_t(width) * height);
+    }
+  }
+
+  return r;
+}
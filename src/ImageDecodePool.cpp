@@ -0,0 +1,54 @@
+#include <ImageDecodePool.h>
+
+using namespace std;
+using namespace canvas;
+
+ImageDecodePool::ImageDecodePool(unsigned int num_threads) {
+  if (!num_threads) {
+    // leave one core for the rendering thread
+    unsigned int n = std::thread::hardware_concurrency();
+    num_threads = n > 1 ? n - 1 : 1;
+  }
+  for (unsigned int i = 0; i < num_threads; i++) {
+    threads.push_back(std::thread(&ImageDecodePool::run, this));
+  }
+}
+
+ImageDecodePool::~ImageDecodePool() {
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    stopping = true;
+  }
+  cond.notify_all();
+  for (auto & t : threads) t.join();
+}
+
+void
+ImageDecodePool::enqueue(int priority, std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    tasks.push(Task { priority, next_sequence++, std::move(task) });
+  }
+  cond.notify_one();
+}
+
+size_t
+ImageDecodePool::getQueueSize() const {
+  std::lock_guard<std::mutex> guard(mutex);
+  return tasks.size();
+}
+
+void
+ImageDecodePool::run() {
+  while (1) {
+    std::function<void()> func;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.wait(lock, [this]() { return stopping || !tasks.empty(); });
+      if (tasks.empty()) return;
+      func = std::move(const_cast<Task &>(tasks.top()).func);
+      tasks.pop();
+    }
+    func();
+  }
+}
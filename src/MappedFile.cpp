@@ -0,0 +1,67 @@
+#include <MappedFile.h>
+
+#include <cstdio>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace canvas;
+
+MappedFile::MappedFile(const std::string & filename) {
+#ifndef _WIN32
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void * ptr = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (ptr != MAP_FAILED) {
+	data = (unsigned char *)ptr;
+	size = st.st_size;
+	is_mapped = true;
+      }
+    }
+    close(fd);
+    if (is_mapped) return;
+  }
+#endif
+  FILE * in = fopen(filename.c_str(), "rb");
+  if (in) {
+    if (fseek(in, 0, SEEK_END) == 0) {
+      long s = ftell(in);
+      if (s > 0 && fseek(in, 0, SEEK_SET) == 0) {
+	data = new unsigned char[s];
+	size = s;
+	if (fread(data, 1, size, in) != size) {
+	  delete[] data;
+	  data = 0;
+	  size = 0;
+	}
+      }
+    }
+    fclose(in);
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (is_mapped) {
+#ifndef _WIN32
+    munmap(data, size);
+#endif
+  } else {
+    delete[] data;
+  }
+}
+
+void
+MappedFile::adviseSequential() {
+#ifndef _WIN32
+  if (is_mapped) {
+    madvise(data, size, MADV_SEQUENTIAL);
+  }
+#endif
+}
@@ -0,0 +1,45 @@
+#include <Matrix.h>
+
+#if defined __SSE2__ || defined _M_X64
+#include <emmintrin.h>
+#define CANVAS_MATRIX_SSE2
+#elif defined __ARM_NEON || defined __ARM_NEON__
+#include <arm_neon.h>
+#define CANVAS_MATRIX_NEON
+#endif
+
+using namespace canvas;
+
+void
+Matrix::multiply(const float * in, float * out, size_t count) const {
+  size_t i = 0;
+  // two points per vector: x' = x * a + y * c + e, y' = x * b + y * d + f,
+  // with translate and scale matrices using the same terms
+#if defined CANVAS_MATRIX_SSE2
+  const __m128 m0 = _mm_setr_ps(float(a), float(b), float(a), float(b));
+  const __m128 m1 = _mm_setr_ps(float(c), float(d), float(c), float(d));
+  const __m128 m2 = _mm_setr_ps(float(e), float(f), float(e), float(f));
+  for (; i + 2 <= count; i += 2) {
+    __m128 p = _mm_loadu_ps(in + 2 * i);
+    __m128 xx = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 0, 0));
+    __m128 yy = _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 1, 1));
+    _mm_storeu_ps(out + 2 * i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(xx, m0), _mm_mul_ps(yy, m1)), m2));
+  }
+#elif defined CANVAS_MATRIX_NEON
+  const float ma[4] = { float(a), float(b), float(a), float(b) };
+  const float mc[4] = { float(c), float(d), float(c), float(d) };
+  const float me[4] = { float(e), float(f), float(e), float(f) };
+  const float32x4_t m0 = vld1q_f32(ma), m1 = vld1q_f32(mc), m2 = vld1q_f32(me);
+  for (; i + 2 <= count; i += 2) {
+    float32x2x2_t xy = vld2_f32(in + 2 * i); // { x0, x1 }, { y0, y1 }
+    float32x4_t xx = vcombine_f32(vdup_lane_f32(xy.val[0], 0), vdup_lane_f32(xy.val[0], 1));
+    float32x4_t yy = vcombine_f32(vdup_lane_f32(xy.val[1], 0), vdup_lane_f32(xy.val[1], 1));
+    vst1q_f32(out + 2 * i, vmlaq_f32(vmlaq_f32(m2, xx, m0), yy, m1));
+  }
+#endif
+  for (; i < count; i++) {
+    Point p = multiply(in[2 * i], in[2 * i + 1]);
+    out[2 * i] = float(p.x);
+    out[2 * i + 1] = float(p.y);
+  }
+}
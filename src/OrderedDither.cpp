@@ -0,0 +1,96 @@
+#include "OrderedDither.h"
+#include "PackedPixel.h"
+
+#include <ImageDataView.h>
+#include <ParallelFor.h>
+
+#include <cassert>
+
+using namespace std;
+using namespace canvas;
+
+static const unsigned char bayer_matrix[8][8] = {
+  {  0, 32,  8, 40,  2, 34, 10, 42 },
+  { 48, 16, 56, 24, 50, 18, 58, 26 },
+  { 12, 44,  4, 36, 14, 46,  6, 38 },
+  { 60, 28, 52, 20, 62, 30, 54, 22 },
+  {  3, 35, 11, 43,  1, 33,  9, 41 },
+  { 51, 19, 59, 27, 49, 17, 57, 25 },
+  { 15, 47,  7, 39, 13, 45,  5, 37 },
+  { 63, 31, 55, 23, 61, 29, 53, 21 }
+};
+
+static inline unsigned int quantize(unsigned int v, unsigned int offset, unsigned int bits) {
+  v += offset;
+  return (v > 255 ? 255 : v) >> (8 - bits);
+}
+
+template<class P, unsigned int num_channels>
+static inline unsigned short ditherPixel(const unsigned char * p, unsigned int red_offset, unsigned int green_offset, unsigned int blue_offset, unsigned int alpha_offset) {
+  unsigned int red = p[0];
+  unsigned int green = num_channels >= 3 ? p[1] : red;
+  unsigned int blue = num_channels >= 3 ? p[2] : red;
+  unsigned int alpha = num_channels == 4 ? p[3] : (num_channels == 2 ? p[1] : 0xff);
+  return P::pack(quantize(red, red_offset, P::red_bits),
+		 quantize(green, green_offset, P::green_bits),
+		 quantize(blue, blue_offset, P::blue_bits),
+		 P::alpha_bits ? quantize(alpha, alpha_offset, P::alpha_bits) : 0);
+}
+
+// Each output pixel only depends on its own input pixel and position, so the
+// inner loop has no carried state and rows can be processed in any order.
+template<class P, unsigned int num_channels>
+static void ditherRows(const ImageDataView & input, unsigned int width, unsigned int y0, unsigned int y1, unsigned short * output) {
+  for (unsigned int y = y0; y < y1; y++) {
+    unsigned char red_offsets[8], green_offsets[8], blue_offsets[8], alpha_offsets[8];
+    for (unsigned int i = 0; i < 8; i++) {
+      unsigned int t = bayer_matrix[y & 7][i];
+      red_offsets[i] = (t << (8 - P::red_bits)) >> 6;
+      green_offsets[i] = (t << (8 - P::green_bits)) >> 6;
+      blue_offsets[i] = (t << (8 - P::blue_bits)) >> 6;
+      alpha_offsets[i] = P::alpha_bits ? (t << (8 - P::alpha_bits)) >> 6 : 0;
+    }
+    const unsigned char * row = input.getRow(y);
+    unsigned short * out = output + size_t(y) * width;
+    // the matrix row repeats every 8 pixels, so 8 pixel blocks use constant offsets per lane
+    unsigned int x = 0;
+    for (; x + 8 <= width; x += 8) {
+      for (unsigned int i = 0; i < 8; i++) {
+	out[x + i] = ditherPixel<P, num_channels>(row + (x + i) * num_channels, red_offsets[i], green_offsets[i], blue_offsets[i], alpha_offsets[i]);
+      }
+    }
+    for (; x < width; x++) {
+      unsigned int i = x & 7;
+      out[x] = ditherPixel<P, num_channels>(row + x * num_channels, red_offsets[i], green_offsets[i], blue_offsets[i], alpha_offsets[i]);
+    }
+  }
+}
+
+template<class P>
+static void dither(const ImageDataView & input, unsigned short * output) {
+  unsigned int width = input.getWidth(), height = input.getHeight();
+  unsigned int min_rows = 65536 / (width ? width : 1) + 1;
+  unsigned int num_channels = input.getNumChannels();
+  parallelFor(height, min_rows, [=](unsigned int y0, unsigned int y1) {
+      switch (num_channels) {
+      case 1: ditherRows<P, 1>(input, width, y0, y1, output); break;
+      case 2: ditherRows<P, 2>(input, width, y0, y1, output); break;
+      case 3: ditherRows<P, 3>(input, width, y0, y1, output); break;
+      default: ditherRows<P, 4>(input, width, y0, y1, output); break;
+      }
+    });
+}
+
+size_t
+OrderedDither::apply(const ImageDataView & input_image, unsigned char * output) const {
+  switch (target_format) {
+  case RGBA4: dither<PackedPixel<RGBA4> >(input_image, (unsigned short *)output); break;
+  case RGB565: dither<PackedPixel<RGB565> >(input_image, (unsigned short *)output); break;
+  case RGBA5551: dither<PackedPixel<RGBA5551> >(input_image, (unsigned short *)output); break;
+  default:
+    assert(0);
+    return 0;
+  }
+
+  return size_t(input_image.getWidth()) * input_image.getHeight() * 2;
+}
@@ -1,20 +1,90 @@
 #include <PackedImageData.h>
 
 #include <FloydSteinberg.h>
+#include <OrderedDither.h>
 #include <ImageData.h>
+#include <ImageDataView.h>
+#include <ParallelFor.h>
+#include <MappedFile.h>
+#include <ImageLoadingException.h>
 
 #include "rg_etc1.h"
 #include "dxt.h"
+#include "PackedPixel.h"
 
 #include <cassert>
+#include <cstdio>
+#include <mutex>
 
 using namespace std;
 using namespace canvas;
 
-bool PackedImageData::etc1_initialized = false;
+static std::once_flag etc1_initialized;
 
-PackedImageData::PackedImageData(InternalFormat _format, unsigned short _levels, const ImageData & input)
-  : format(_format), width(input.getWidth()), height(input.getHeight()), levels(_levels)
+static inline bool isCompressed(InternalFormat format) {
+  return format == RGB_ETC1 || format == RGB_DXT1 || format == RGBA_DXT5 || format == RED_RGTC1 || format == RG_RGTC2;
+}
+
+static inline unsigned int getBlockSize(InternalFormat format) {
+  return format == RGBA_DXT5 || format == RG_RGTC2 ? 16 : 8;
+}
+
+// Compresses an image into 4x4 blocks. Partial blocks at the right and
+// bottom edges are padded by repeating the last row and column.
+static size_t compressBlocks(InternalFormat format, unsigned short quality, const ImageDataView & img, unsigned char * output) {
+  if (format == RGB_ETC1) {
+    std::call_once(etc1_initialized, rg_etc1::pack_etc1_block_init);
+  }
+  
+  unsigned int w = img.getWidth(), h = img.getHeight(), num_channels = img.getNumChannels();
+  unsigned int cols = (w + 3) / 4, rows = (h + 3) / 4, block_size = getBlockSize(format);
+  parallelFor(rows, 4, [=](unsigned int row0, unsigned int row1) {
+      rg_etc1::etc1_pack_params params;
+      params.m_quality = quality >= 2 ? rg_etc1::cHighQuality : (quality == 1 ? rg_etc1::cMediumQuality : rg_etc1::cLowQuality);
+      int dxt_mode = quality >= 1 ? STB_DXT_HIGHQUAL : STB_DXT_NORMAL;
+      unsigned char block[4 * 4 * 4];
+      for (unsigned int row = row0; row < row1; row++) {
+	for (unsigned int col = 0; col < cols; col++) {
+	  for (unsigned int y = 0; y < 4; y++) {
+	    unsigned int sy = row * 4 + y < h ? row * 4 + y : h - 1;
+	    for (unsigned int x = 0; x < 4; x++) {
+	      unsigned int sx = col * 4 + x < w ? col * 4 + x : w - 1;
+	      const unsigned char * p = img.getRow(sy) + sx * num_channels;
+	      unsigned char r = p[0];
+	      unsigned char g = num_channels >= 3 ? p[1] : r;
+	      unsigned char b = num_channels >= 3 ? p[2] : r;
+	      unsigned char a = num_channels == 4 ? p[3] : (num_channels == 2 ? p[1] : 0xff);
+	      unsigned int i = y * 4 + x;
+	      if (format == RED_RGTC1) {
+		block[i] = r;
+	      } else if (format == RG_RGTC2) {
+		block[2 * i + 0] = r;
+		block[2 * i + 1] = a;
+	      } else {
+		block[4 * i + 0] = r;
+		block[4 * i + 1] = g;
+		block[4 * i + 2] = b;
+		block[4 * i + 3] = format == RGBA_DXT5 ? a : 0xff;
+	      }
+	    }
+	  }
+	  unsigned char * dest = output + (size_t(row) * cols + col) * block_size;
+	  switch (format) {
+	  case RGB_ETC1: rg_etc1::pack_etc1_block(dest, (const unsigned int *)block, params); break;
+	  case RGB_DXT1: stb_compress_dxt1_block(dest, block, false, dxt_mode); break;
+	  case RGBA_DXT5: stb_compress_dxt1_block(dest, block, true, dxt_mode); break;
+	  case RED_RGTC1: stb_compress_rgtc1_block(dest, block); break;
+	  default: stb_compress_rgtc2_block(dest, block); break;
+	  }
+	}
+      }
+    });
+
+  return size_t(rows) * cols * block_size;
+}
+
+PackedImageData::PackedImageData(InternalFormat _format, unsigned short _levels, const ImageDataView & input, Dithering dithering, unsigned short _quality)
+  : format(_format), width(input.getWidth()), height(input.getHeight()), levels(_levels), quality(_quality)
 {
   if (format == NO_FORMAT) {
     if (input.getNumChannels() == 4) format = RGBA8;
@@ -29,19 +99,30 @@ PackedImageData::PackedImageData(InternalFormat _format, unsigned short _levels,
   unsigned short num_channels = input.getNumChannels();
 
   size_t s = calculateSize();
-  data = std::unique_ptr<unsigned char[]>(new unsigned char[s]);
+  data = allocatePixelBuffer(s);
   
   if ((num_channels == 4 && (format == RGB8 || format == RGBA8)) ||
       (num_channels == 1 && format == R8)) {
     assert(levels == 1);
-    memcpy(data.get(), input.getData(), s);
-  } else if (format == RGBA4 || format == RGB565) {
+    size_t row_size = size_t(width) * num_channels;
+    for (unsigned int y = 0; y < height; y++) {
+      memcpy(data.get() + y * row_size, input.getRow(y), row_size);
+    }
+  } else if (format == RGBA4 || format == RGB565 || format == RGBA5551 || isCompressed(format)) {
     FloydSteinberg fs(format);
-    unsigned int offset = fs.apply(input, data.get());
+    OrderedDither od(format);
+    auto apply = [&](const ImageDataView & img, unsigned char * output) {
+      if (isCompressed(format)) {
+	return compressBlocks(format, quality, img, output);
+      } else {
+	return dithering == ORDERED_DITHER ? od.apply(img, output) : fs.apply(img, output);
+      }
+    };
+    size_t offset = apply(input, data.get());
     if (levels >= 2) {
       auto img = input.scale((input.getWidth() + 1) / 2, (input.getHeight() + 1) / 2);
       for (unsigned int l = 1; l < levels; l++) {
-	offset += fs.apply(*img, data.get() + offset);
+	offset += apply(*img, data.get() + offset);
 	if (l + 1 < levels) {
 	  img = img->scale((img->getWidth() + 1) / 2, (img->getHeight() + 1) / 2);
 	}
@@ -50,33 +131,36 @@ PackedImageData::PackedImageData(InternalFormat _format, unsigned short _levels,
   } else {
     assert(levels == 1);
     
-    const unsigned char * input_data = input.getData();
-
     if (format == RGB8 || format == RGBA8) {
       unsigned int * output_data = (unsigned int *)data.get();
-      if (num_channels == 3) {
-	for (unsigned int i = 0; i < 3 * width * height; i += 3) {
-	  *output_data++ = (0xff << 24) | (input_data[i] << 16) | (input_data[i + 1] << 8) | (input_data[i + 2]);
-	}
-      } else if (num_channels == 1) {
-	for (unsigned int i = 0; i < width * height; i++) {
-	  unsigned char v = input_data[i];
-	  *output_data++ = (0xff << 24) | (v << 16) | (v << 8) | (v);
+      for (unsigned int y = 0; y < height; y++) {
+	const unsigned char * input_data = input.getRow(y);
+	if (num_channels == 3) {
+	  for (unsigned int i = 0; i < 3 * width; i += 3) {
+	    *output_data++ = (0xff << 24) | (input_data[i] << 16) | (input_data[i + 1] << 8) | (input_data[i + 2]);
+	  }
+	} else if (num_channels == 1) {
+	  for (unsigned int i = 0; i < width; i++) {
+	    unsigned char v = input_data[i];
+	    *output_data++ = (0xff << 24) | (v << 16) | (v << 8) | (v);
+	  }
 	}
       }
     } else if (format == LA44) {
       unsigned char * output_data = (unsigned char *)data.get();
-      unsigned int n = width * height;
       
-      for (unsigned int i = 0; i < n; i++) {
-	unsigned int input_offset = i * num_channels;
-	unsigned char r = input_data[input_offset++];
-	unsigned char g = num_channels >= 2 ? input_data[input_offset++] : r;
-	unsigned char b = num_channels >= 3 ? input_data[input_offset++] : g;
-	unsigned char a = (num_channels >= 4 ? input_data[input_offset++] : 0xff) >> 4;
-	unsigned int lum = ((r + g + b) / 3) >> 4;
-	if (lum >= 16) lum = 15;
-	*output_data++ = (a << 4) | lum;
+      for (unsigned int y = 0; y < height; y++) {
+	const unsigned char * input_data = input.getRow(y);
+	for (unsigned int i = 0; i < width; i++) {
+	  unsigned int input_offset = i * num_channels;
+	  unsigned char r = input_data[input_offset++];
+	  unsigned char g = num_channels >= 2 ? input_data[input_offset++] : r;
+	  unsigned char b = num_channels >= 3 ? input_data[input_offset++] : g;
+	  unsigned char a = (num_channels >= 4 ? input_data[input_offset++] : 0xff) >> 4;
+	  unsigned int lum = ((r + g + b) / 3) >> 4;
+	  if (lum >= 16) lum = 15;
+	  *output_data++ = (a << 4) | lum;
+	}
       }
     } else {
       // cerr << "unable to pack input data (channels = " << input.getNumChannels() << ", f = " << int(format) << ")\n";
@@ -85,30 +169,30 @@ PackedImageData::PackedImageData(InternalFormat _format, unsigned short _levels,
   }
 }
 
-PackedImageData::PackedImageData(InternalFormat _format, unsigned short _width, unsigned short _height, unsigned short _levels, const unsigned char * input)
+PackedImageData::PackedImageData(InternalFormat _format, unsigned int _width, unsigned int _height, unsigned short _levels, const unsigned char * input)
   : width(_width), height(_height), levels(_levels), format(_format) {
   size_t s = calculateSize();
-  data = std::unique_ptr<unsigned char[]>(new unsigned char[s]);
+  data = allocatePixelBuffer(s);
   if (input) {
     memcpy(data.get(), input, s);
   } else {
     if (format == RGB_ETC1) {
-      for (unsigned int i = 0; i < s; i += 8) {
+      for (size_t i = 0; i < s; i += 8) {
 	*(unsigned int *)(data.get() + i + 0) = 0x00000000;
 	*(unsigned int *)(data.get() + i + 4) = 0xffffffff;
       }
     } else if (format == RGB_DXT1) {
-      for (unsigned int i = 0; i < s; i += 8) {
+      for (size_t i = 0; i < s; i += 8) {
 	*(unsigned int *)(data.get() + i + 0) = 0x00000000;
 	*(unsigned int *)(data.get() + i + 4) = 0xaaaaaaaa;
       }
     } else if (format == RED_RGTC1) {
-      for (unsigned int i = 0; i < s; i += 8) {
+      for (size_t i = 0; i < s; i += 8) {
 	*(unsigned int *)(data.get() + i + 0) = 0x00000003; // doesn't work on big endian
 	*(unsigned int *)(data.get() + i + 4) = 0x00000000;
       }
     } else if (format == RG_RGTC2) {
-      for (unsigned int i = 0; i < s; i += 16) {
+      for (size_t i = 0; i < s; i += 16) {
 	*(unsigned int *)(data.get() + i + 0) = 0x00000003;
 	*(unsigned int *)(data.get() + i + 4) = 0x00000000;
 	*(unsigned int *)(data.get() + i + 8) = 0x00000003;
@@ -120,6 +204,446 @@ PackedImageData::PackedImageData(InternalFormat _format, unsigned short _width,
   }
 }
 
+static inline void decode_rgb565(unsigned int v, unsigned char * rgba) {
+  rgba[0] = expandBits(v >> 11, 5);
+  rgba[1] = expandBits((v >> 5) & 0x3f, 6);
+  rgba[2] = expandBits(v & 0x1f, 5);
+  rgba[3] = 0xff;
+}
+
+// Decodes the color part of a DXT1 / DXT5 block into 16 RGBA pixels
+static void decode_dxt_color_block(const unsigned char * block, unsigned char * pixels, bool has_alpha_block) {
+  unsigned int c0 = block[0] | (block[1] << 8), c1 = block[2] | (block[3] << 8);
+  unsigned char colors[4][4];
+  decode_rgb565(c0, colors[0]);
+  decode_rgb565(c1, colors[1]);
+  if (c0 > c1 || has_alpha_block) {
+    for (unsigned int c = 0; c < 3; c++) {
+      colors[2][c] = (2 * colors[0][c] + colors[1][c]) / 3;
+      colors[3][c] = (colors[0][c] + 2 * colors[1][c]) / 3;
+    }
+    colors[2][3] = colors[3][3] = 0xff;
+  } else {
+    for (unsigned int c = 0; c < 3; c++) {
+      colors[2][c] = (colors[0][c] + colors[1][c]) / 2;
+      colors[3][c] = 0;
+    }
+    colors[2][3] = 0xff;
+    colors[3][3] = 0;
+  }
+  unsigned int indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((unsigned int)block[7] << 24);
+  for (unsigned int i = 0; i < 16; i++, indices >>= 2) {
+    memcpy(pixels + 4 * i, colors[indices & 3], 4);
+  }
+}
+
+// Decodes an RGTC1 / DXT5 alpha block into 16 values written with the given stride
+static void decode_rgtc_block(const unsigned char * block, unsigned char * values, unsigned int stride) {
+  unsigned int v0 = block[0], v1 = block[1];
+  unsigned char palette[8];
+  palette[0] = v0;
+  palette[1] = v1;
+  if (v0 > v1) {
+    for (unsigned int i = 1; i < 7; i++) palette[i + 1] = ((7 - i) * v0 + i * v1) / 7;
+  } else {
+    for (unsigned int i = 1; i < 5; i++) palette[i + 1] = ((5 - i) * v0 + i * v1) / 5;
+    palette[6] = 0;
+    palette[7] = 0xff;
+  }
+  unsigned long long bits = 0;
+  for (unsigned int i = 0; i < 6; i++) bits |= (unsigned long long)block[2 + i] << (8 * i);
+  for (unsigned int i = 0; i < 16; i++, bits >>= 3) {
+    values[i * stride] = palette[bits & 7];
+  }
+}
+
+// Decodes one 4x4 block into RGBA pixels
+static void decode_block(InternalFormat format, const unsigned char * block, unsigned char * pixels) {
+  switch (format) {
+  case RGB_ETC1:
+    rg_etc1::unpack_etc1_block(block, (unsigned int *)pixels);
+    break;
+  case RGB_DXT1:
+    decode_dxt_color_block(block, pixels, false);
+    break;
+  case RGBA_DXT5:
+    decode_dxt_color_block(block + 8, pixels, true);
+    decode_rgtc_block(block, pixels + 3, 4);
+    break;
+  case RED_RGTC1:
+    decode_rgtc_block(block, pixels, 4);
+    break;
+  case RG_RGTC2:
+    decode_rgtc_block(block, pixels, 4);
+    decode_rgtc_block(block + 8, pixels + 1, 4);
+    break;
+  default:
+    assert(0);
+  }
+}
+
+std::unique_ptr<ImageData>
+PackedImageData::unpack(unsigned short level) const {
+  assert(level < levels);
+  unsigned int w = width, h = height;
+  for (unsigned int l = 0; l < level; l++) {
+    w = (w + 1) / 2;
+    h = (h + 1) / 2;
+  }
+  unsigned short num_channels = getNumChannels(format);
+  std::unique_ptr<ImageData> r(new ImageData(w, h, num_channels, false));
+  const unsigned char * input = getDataForLevel(level);
+  unsigned char * output = r->getData();
+  InternalFormat f = format;
+  
+  if (isCompressed(f)) {
+    unsigned int cols = (w + 3) / 4, rows = (h + 3) / 4, block_size = getBlockSize(f);
+    parallelFor(rows, 16, [=](unsigned int row0, unsigned int row1) {
+	unsigned char pixels[4 * 4 * 4];
+	for (unsigned int row = row0; row < row1; row++) {
+	  for (unsigned int col = 0; col < cols; col++) {
+	    decode_block(f, input + (size_t(row) * cols + col) * block_size, pixels);
+	    for (unsigned int y = 0; y < 4 && row * 4 + y < h; y++) {
+	      for (unsigned int x = 0; x < 4 && col * 4 + x < w; x++) {
+		const unsigned char * src = pixels + (y * 4 + x) * 4;
+		unsigned char * dest = output + ((size_t(row) * 4 + y) * w + col * 4 + x) * num_channels;
+		for (unsigned int c = 0; c < num_channels; c++) dest[c] = src[c];
+	      }
+	    }
+	  }
+	}
+      });
+  } else if (f == RGB565 || f == RGBA4 || f == RGBA5551) {
+    parallelFor(h, 64, [=](unsigned int y0, unsigned int y1) {
+	const unsigned short * in = (const unsigned short *)input + size_t(y0) * w;
+	unsigned char * out = output + size_t(y0) * w * num_channels;
+	for (size_t i = size_t(y0) * w; i < size_t(y1) * w; i++, out += num_channels) {
+	  unsigned int red, green, blue, alpha;
+	  switch (f) {
+	  case RGB565: PackedPixel<RGB565>::unpack(*in++, red, green, blue, alpha); break;
+	  case RGBA4: PackedPixel<RGBA4>::unpack(*in++, red, green, blue, alpha); break;
+	  default: PackedPixel<RGBA5551>::unpack(*in++, red, green, blue, alpha); break;
+	  }
+	  out[0] = red;
+	  out[1] = green;
+	  out[2] = blue;
+	  if (num_channels == 4) out[3] = alpha;
+	}
+      });
+  } else if (f == LA44) {
+    for (size_t i = 0; i < size_t(w) * h; i++) {
+      unsigned char v = input[i];
+      output[2 * i + 0] = (v & 0x0f) * 17;
+      output[2 * i + 1] = (v >> 4) * 17;
+    }
+  } else if (f == R32F) {
+    const float * in = (const float *)input;
+    for (size_t i = 0; i < size_t(w) * h; i++) {
+      float v = in[i];
+      output[i] = v <= 0.0f ? 0 : (v >= 1.0f ? 255 : (unsigned char)(v * 255.0f + 0.5f));
+    }
+  } else {
+    // R8, RG8, LUMINANCE_ALPHA, RGB8 and RGBA8 are stored with 8 bits per channel
+    assert(getBytesPerPixel(f) == num_channels);
+    memcpy(output, input, size_t(w) * h * num_channels);
+  }
+
+  return r;
+}
+
+double
+PackedImageData::calculatePSNR(const ImageData & original, unsigned short level) const {
+  return unpack(level)->calculatePSNR(original);
+}
+
+struct KTXFormat {
+  InternalFormat format;
+  unsigned int gl_type, gl_type_size, gl_format, gl_internal_format, gl_base_internal_format;
+};
+
+// LA44 is not a real OpenGL format, so it is stored like a compressed format
+// with the closest matching internal format, and its rows are not padded.
+static const KTXFormat ktx_formats[] = {
+  { R8, 0x1401, 1, 0x1903, 0x8229, 0x1903 },
+  { RG8, 0x1401, 1, 0x8227, 0x822b, 0x8227 },
+  { RGB565, 0x8363, 2, 0x1907, 0x8d62, 0x1907 },
+  { RGBA4, 0x8033, 2, 0x1908, 0x8056, 0x1908 },
+  { RGBA8, 0x1401, 1, 0x1908, 0x8058, 0x1908 },
+  { RGB8, 0x1401, 1, 0x1908, 0x8051, 0x1907 },
+  { RED_RGTC1, 0, 1, 0, 0x8dbb, 0x1903 },
+  { RG_RGTC2, 0, 1, 0, 0x8dbd, 0x8227 },
+  { RGB_DXT1, 0, 1, 0, 0x83f0, 0x1907 },
+  { RGBA_DXT5, 0, 1, 0, 0x83f3, 0x1908 },
+  { RGB_ETC1, 0, 1, 0, 0x8d64, 0x1907 },
+  { LUMINANCE_ALPHA, 0x1401, 1, 0x190a, 0x190a, 0x190a },
+  { LA44, 0, 1, 0, 0x8043, 0x190a },
+  { R32F, 0x1406, 4, 0x1903, 0x822e, 0x1903 },
+  { RGBA5551, 0x8034, 2, 0x1908, 0x8057, 0x1908 }
+};
+
+static const unsigned char ktx_identifier[12] = { 0xab, 0x4b, 0x54, 0x58, 0x20, 0x31, 0x31, 0xbb, 0x0d, 0x0a, 0x1a, 0x0a };
+
+static const unsigned int DDS_MAGIC = 0x20534444; // "DDS "
+static const unsigned int DDSD_CAPS = 0x1, DDSD_HEIGHT = 0x2, DDSD_WIDTH = 0x4, DDSD_PITCH = 0x8, DDSD_PIXELFORMAT = 0x1000, DDSD_MIPMAPCOUNT = 0x20000, DDSD_LINEARSIZE = 0x80000;
+static const unsigned int DDPF_ALPHAPIXELS = 0x1, DDPF_FOURCC = 0x4, DDPF_RGB = 0x40, DDPF_LUMINANCE = 0x20000;
+static const unsigned int DDSCAPS_COMPLEX = 0x8, DDSCAPS_TEXTURE = 0x1000, DDSCAPS_MIPMAP = 0x400000;
+
+// The 16-bit formats are stored in files with red in the high bits, as
+// the OpenGL packed types define them. Other platforms keep blue there in
+// memory (see PackedPixel.h), so those swap red and blue on save and load.
+static inline bool isSwizzled(InternalFormat format) {
+#if defined __APPLE__ || defined __ANDROID__
+  return false;
+#else
+  return format == RGB565 || format == RGBA4 || format == RGBA5551;
+#endif
+}
+
+static inline unsigned short swapRedBlue(InternalFormat format, unsigned short v) {
+  switch (format) {
+  case RGB565: return (v & 0x07e0) | (v >> 11) | ((v & 0x001f) << 11);
+  case RGBA4: return (v & 0x0f0f) | ((v >> 8) & 0x00f0) | ((v & 0x00f0) << 8);
+  case RGBA5551: return (v & 0x07c1) | ((v >> 10) & 0x003e) | ((v & 0x003e) << 10);
+  default: return v;
+  }
+}
+
+static void swapRedBlue(InternalFormat format, unsigned char * data, size_t size) {
+  unsigned short * p = (unsigned short *)data;
+  for (size_t i = 0; i < size / 2; i++) p[i] = swapRedBlue(format, p[i]);
+}
+
+// Writes level data in the file layout
+static bool writeData(FILE * out, InternalFormat format, const unsigned char * data, size_t size) {
+  if (!isSwizzled(format)) return fwrite(data, 1, size, out) == size;
+  unsigned char buffer[4096];
+  for (size_t offset = 0; offset < size; offset += sizeof(buffer)) {
+    size_t n = std::min(sizeof(buffer), size - offset);
+    memcpy(buffer, data + offset, n);
+    swapRedBlue(format, buffer, n);
+    if (fwrite(buffer, 1, n, out) != n) return false;
+  }
+  return true;
+}
+
+static inline unsigned int fourCC(char a, char b, char c, char d) {
+  return (unsigned int)a | ((unsigned int)b << 8) | ((unsigned int)c << 16) | ((unsigned int)d << 24);
+}
+
+// Fills in the eight DDS_PIXELFORMAT fields. ETC1 has no standard DDS
+// code, so the commonly used "ETC1" four character code is written.
+static bool getDDSPixelFormat(InternalFormat format, unsigned int * pf) {
+  pf[0] = 32;
+  for (unsigned int i = 1; i < 8; i++) pf[i] = 0;
+  switch (format) {
+  case R8: pf[1] = DDPF_LUMINANCE; pf[3] = 8; pf[4] = 0xff; break;
+  case RG8: pf[1] = DDPF_RGB; pf[3] = 16; pf[4] = 0x00ff; pf[5] = 0xff00; break;
+  case RGB565: pf[1] = DDPF_RGB; pf[3] = 16; pf[4] = 0xf800; pf[5] = 0x07e0; pf[6] = 0x001f; break;
+  case RGBA4: pf[1] = DDPF_RGB | DDPF_ALPHAPIXELS; pf[3] = 16; pf[4] = 0xf000; pf[5] = 0x0f00; pf[6] = 0x00f0; pf[7] = 0x000f; break;
+  case RGBA5551: pf[1] = DDPF_RGB | DDPF_ALPHAPIXELS; pf[3] = 16; pf[4] = 0xf800; pf[5] = 0x07c0; pf[6] = 0x003e; pf[7] = 0x0001; break;
+  case RGBA8: pf[1] = DDPF_RGB | DDPF_ALPHAPIXELS; pf[3] = 32; pf[4] = 0xff; pf[5] = 0xff00; pf[6] = 0xff0000; pf[7] = 0xff000000; break;
+  case RGB8: pf[1] = DDPF_RGB; pf[3] = 32; pf[4] = 0xff; pf[5] = 0xff00; pf[6] = 0xff0000; break;
+  case LUMINANCE_ALPHA: pf[1] = DDPF_LUMINANCE | DDPF_ALPHAPIXELS; pf[3] = 16; pf[4] = 0xff; pf[7] = 0xff00; break;
+  case LA44: pf[1] = DDPF_LUMINANCE | DDPF_ALPHAPIXELS; pf[3] = 8; pf[4] = 0x0f; pf[7] = 0xf0; break;
+  case R32F: pf[1] = DDPF_FOURCC; pf[2] = 114; break;
+  case RED_RGTC1: pf[1] = DDPF_FOURCC; pf[2] = fourCC('A', 'T', 'I', '1'); break;
+  case RG_RGTC2: pf[1] = DDPF_FOURCC; pf[2] = fourCC('A', 'T', 'I', '2'); break;
+  case RGB_DXT1: pf[1] = DDPF_FOURCC; pf[2] = fourCC('D', 'X', 'T', '1'); break;
+  case RGBA_DXT5: pf[1] = DDPF_FOURCC; pf[2] = fourCC('D', 'X', 'T', '5'); break;
+  case RGB_ETC1: pf[1] = DDPF_FOURCC; pf[2] = fourCC('E', 'T', 'C', '1'); break;
+  case NO_FORMAT: return false;
+  }
+  return true;
+}
+
+static inline unsigned int readUInt32(const unsigned char * p) {
+  unsigned int v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+bool
+PackedImageData::isKTX(const unsigned char * buffer, size_t size) {
+  return size >= 64 && memcmp(buffer, ktx_identifier, 12) == 0;
+}
+
+bool
+PackedImageData::isDDS(const unsigned char * buffer, size_t size) {
+  return size >= 128 && readUInt32(buffer) == DDS_MAGIC && readUInt32(buffer + 4) == 124;
+}
+
+bool
+PackedImageData::saveKTX(const std::string & filename) const {
+  const KTXFormat * kf = 0;
+  for (auto & f : ktx_formats) {
+    if (f.format == format) kf = &f;
+  }
+  if (!kf || !data.get()) return false;
+
+  FILE * out = fopen(filename.c_str(), "wb");
+  if (!out) return false;
+
+  unsigned int header[13] = { 0x04030201, kf->gl_type, kf->gl_type_size, kf->gl_format, kf->gl_internal_format, kf->gl_base_internal_format, width, height, 0, 0, 1, levels, 0 };
+  bool r = fwrite(ktx_identifier, 1, 12, out) == 12 && fwrite(header, 4, 13, out) == 13;
+
+  // uncompressed rows are padded to four bytes
+  const unsigned char zeros[4] = { 0, 0, 0, 0 };
+  unsigned int w = width, h = height;
+  for (unsigned int level = 0; level < levels && r; level++) {
+    const unsigned char * level_data = getDataForLevel(level);
+    if (isCompressed(format) || !kf->gl_type) {
+      unsigned int image_size = calculateOffset(w, h, 1, format);
+      r = fwrite(&image_size, 4, 1, out) == 1 && fwrite(level_data, 1, image_size, out) == image_size;
+    } else {
+      unsigned int row_size = w * getBytesPerPixel(format), padding = (4 - row_size % 4) % 4;
+      unsigned int image_size = (row_size + padding) * h;
+      r = fwrite(&image_size, 4, 1, out) == 1;
+      for (unsigned int y = 0; y < h && r; y++) {
+	r = writeData(out, format, level_data + y * row_size, row_size) && fwrite(zeros, 1, padding, out) == padding;
+      }
+    }
+    w = (w + 1) / 2;
+    h = (h + 1) / 2;
+  }
+
+  return fclose(out) == 0 && r;
+}
+
+bool
+PackedImageData::saveDDS(const std::string & filename) const {
+  unsigned int pf[8];
+  if (!getDDSPixelFormat(format, pf) || !data.get()) return false;
+
+  unsigned int header[32];
+  memset(header, 0, sizeof(header));
+  header[0] = DDS_MAGIC;
+  header[1] = 124;
+  header[2] = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | (levels > 1 ? DDSD_MIPMAPCOUNT : 0) | (isCompressed(format) ? DDSD_LINEARSIZE : DDSD_PITCH);
+  header[3] = height;
+  header[4] = width;
+  header[5] = isCompressed(format) ? calculateSizeForFirstLevel() : width * getBytesPerPixel(format);
+  header[7] = levels;
+  memcpy(header + 19, pf, sizeof(pf));
+  header[27] = DDSCAPS_TEXTURE | (levels > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0);
+
+  FILE * out = fopen(filename.c_str(), "wb");
+  if (!out) return false;
+
+  bool r = fwrite(header, 4, 32, out) == 32;
+  for (unsigned int level = 0; level < levels && r; level++) {
+    size_t s = calculateOffset(level + 1) - calculateOffset(level);
+    r = writeData(out, format, getDataForLevel(level), s);
+  }
+
+  return fclose(out) == 0 && r;
+}
+
+std::unique_ptr<PackedImageData>
+PackedImageData::loadFile(const std::string & filename) {
+  std::shared_ptr<MappedFile> file(new MappedFile(filename));
+  if (!file->isValid()) {
+    throw ImageLoadingException("unable to open file");
+  }
+  file->adviseSequential();
+  
+  const unsigned char * buffer = file->getData();
+  size_t size = file->getSize();
+
+  InternalFormat format = NO_FORMAT;
+  unsigned int width, height, levels;
+  // level data is referenced relative to the first level
+  size_t first = 0;
+  std::vector<size_t> level_offsets;
+  bool padded = false;
+  
+  if (isKTX(buffer, size)) {
+    if (readUInt32(buffer + 12) != 0x04030201) {
+      throw ImageLoadingException("unsupported KTX endianness");
+    }
+    unsigned int gl_internal_format = readUInt32(buffer + 28);
+    for (auto & f : ktx_formats) {
+      if (f.gl_internal_format == gl_internal_format) format = f.format;
+    }
+    width = readUInt32(buffer + 36);
+    height = readUInt32(buffer + 40);
+    if (!height) height = 1;
+    if (readUInt32(buffer + 44) > 1 || readUInt32(buffer + 48) > 1 || readUInt32(buffer + 52) != 1) {
+      throw ImageLoadingException("only 2D KTX textures are supported");
+    }
+    levels = readUInt32(buffer + 56);
+    if (!levels) levels = 1;
+    size_t offset = 64 + readUInt32(buffer + 60);
+    unsigned int w = width, h = height;
+    for (unsigned int level = 0; level < levels && format != NO_FORMAT; level++) {
+      if (offset + 4 > size) throw ImageLoadingException("truncated KTX file");
+      unsigned int image_size = readUInt32(buffer + offset);
+      offset += 4;
+      if (offset + image_size > size) throw ImageLoadingException("truncated KTX file");
+      size_t expected = calculateOffset(w, h, 1, format);
+      if (image_size != expected) {
+	// rows were padded to four bytes
+	unsigned int row_size = w * getBytesPerPixel(format);
+	if (isCompressed(format) || image_size != ((row_size + 3) & ~3) * h) {
+	  throw ImageLoadingException("invalid KTX level size");
+	}
+	padded = true;
+      }
+      if (level == 0) first = offset;
+      level_offsets.push_back(offset - first);
+      offset += (image_size + 3) & ~3;
+      w = (w + 1) / 2;
+      h = (h + 1) / 2;
+    }
+  } else if (isDDS(buffer, size)) {
+    height = readUInt32(buffer + 12);
+    width = readUInt32(buffer + 16);
+    levels = readUInt32(buffer + 8) & DDSD_MIPMAPCOUNT ? readUInt32(buffer + 28) : 1;
+    if (!levels) levels = 1;
+    unsigned int pf[8];
+    for (auto & f : ktx_formats) {
+      if (getDDSPixelFormat(f.format, pf) && readUInt32(buffer + 80) == pf[1] && readUInt32(buffer + 84) == pf[2] && readUInt32(buffer + 88) == pf[3] && memcmp(buffer + 92, pf + 4, 16) == 0) {
+	format = f.format;
+      }
+    }
+    first = 128;
+  } else {
+    throw ImageLoadingException("unknown texture container");
+  }
+
+  if (format == NO_FORMAT) {
+    throw ImageLoadingException("unsupported texture format");
+  }
+  if (!width || !height || levels > 32) {
+    throw ImageLoadingException("invalid texture dimensions");
+  }
+  if (level_offsets.empty() && first + calculateSize(width, height, levels, format) > size) {
+    throw ImageLoadingException("truncated texture file");
+  }
+
+  if (padded || isSwizzled(format)) {
+    // gather padded KTX rows into the contiguous in-memory layout
+    size_t s = calculateSize(width, height, levels, format);
+    PixelBuffer output = allocatePixelBuffer(s);
+    unsigned int w = width, h = height;
+    for (unsigned int level = 0; level < levels; level++) {
+      unsigned int row_size = w * getBytesPerPixel(format), padded_row_size = padded ? (row_size + 3) & ~3 : row_size;
+      const unsigned char * input = buffer + first + (level_offsets.empty() ? calculateOffset(width, height, level, format) : level_offsets[level]);
+      unsigned char * target = output.get() + calculateOffset(width, height, level, format);
+      for (unsigned int y = 0; y < h; y++) {
+	memcpy(target + y * row_size, input + y * padded_row_size, row_size);
+      }
+      if (isSwizzled(format)) swapRedBlue(format, target, size_t(row_size) * h);
+      w = (w + 1) / 2;
+      h = (h + 1) / 2;
+    }
+    return std::unique_ptr<PackedImageData>(new PackedImageData(format, width, height, levels, std::move(output)));
+  } else {
+    // the deleter keeps the mapping alive for as long as the levels are in use
+    PixelBuffer mapped(const_cast<unsigned char *>(buffer + first), [file](unsigned char *) { });
+    return std::unique_ptr<PackedImageData>(new PackedImageData(format, width, height, levels, std::move(mapped), std::move(level_offsets)));
+  }
+}
+
 #if 0
 void
 PackedImageData::createMipmaps(const ImageData & input_data, unsigned short target_levels) const {
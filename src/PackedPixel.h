@@ -0,0 +1,87 @@
+#ifndef _PACKEDPIXEL_H_
+#define _PACKEDPIXEL_H_
+
+#include <InternalFormat.h>
+
+namespace canvas {
+  // Channel widths and bit layout of the 16-bit packed formats
+  static inline unsigned int expandBits(unsigned int v, unsigned int bits) {
+    switch (bits) {
+    case 1: return v ? 0xff : 0;
+    case 4: return v * 17;
+    case 5: return (v << 3) | (v >> 2);
+    case 6: return (v << 2) | (v >> 4);
+    default: return v;
+    }
+  }
+
+  template<InternalFormat format> struct PackedPixel { };
+
+  template<> struct PackedPixel<RGBA4> {
+    static const unsigned int red_bits = 4, green_bits = 4, blue_bits = 4, alpha_bits = 4;
+    static inline unsigned short pack(unsigned int r, unsigned int g, unsigned int b, unsigned int a) {
+#if defined __APPLE__ || defined __ANDROID__
+      return (r << 12) | (g << 8) | (b << 4) | a;
+#else
+      return (b << 12) | (g << 8) | (r << 4) | a;
+#endif
+    }
+    static inline void unpack(unsigned int v, unsigned int & r, unsigned int & g, unsigned int & b, unsigned int & a) {
+#if defined __APPLE__ || defined __ANDROID__
+      r = (v >> 12) * 17;
+      b = ((v >> 4) & 0x0f) * 17;
+#else
+      b = (v >> 12) * 17;
+      r = ((v >> 4) & 0x0f) * 17;
+#endif
+      g = ((v >> 8) & 0x0f) * 17;
+      a = (v & 0x0f) * 17;
+    }
+  };
+
+  template<> struct PackedPixel<RGB565> {
+    static const unsigned int red_bits = 5, green_bits = 6, blue_bits = 5, alpha_bits = 0;
+    static inline unsigned short pack(unsigned int r, unsigned int g, unsigned int b, unsigned int /* a */) {
+#if defined __APPLE__ || defined __ANDROID__
+      return b | (g << 5) | (r << 11);
+#else
+      return r | (g << 5) | (b << 11);
+#endif
+    }
+    static inline void unpack(unsigned int v, unsigned int & r, unsigned int & g, unsigned int & b, unsigned int & a) {
+#if defined __APPLE__ || defined __ANDROID__
+      r = expandBits(v >> 11, 5);
+      b = expandBits(v & 0x1f, 5);
+#else
+      b = expandBits(v >> 11, 5);
+      r = expandBits(v & 0x1f, 5);
+#endif
+      g = expandBits((v >> 5) & 0x3f, 6);
+      a = 0xff;
+    }
+  };
+
+  template<> struct PackedPixel<RGBA5551> {
+    static const unsigned int red_bits = 5, green_bits = 5, blue_bits = 5, alpha_bits = 1;
+    static inline unsigned short pack(unsigned int r, unsigned int g, unsigned int b, unsigned int a) {
+#if defined __APPLE__ || defined __ANDROID__
+      return (r << 11) | (g << 6) | (b << 1) | a;
+#else
+      return (b << 11) | (g << 6) | (r << 1) | a;
+#endif
+    }
+    static inline void unpack(unsigned int v, unsigned int & r, unsigned int & g, unsigned int & b, unsigned int & a) {
+#if defined __APPLE__ || defined __ANDROID__
+      r = expandBits(v >> 11, 5);
+      b = expandBits((v >> 1) & 0x1f, 5);
+#else
+      b = expandBits(v >> 11, 5);
+      r = expandBits((v >> 1) & 0x1f, 5);
+#endif
+      g = expandBits((v >> 6) & 0x1f, 5);
+      a = v & 1 ? 0xff : 0;
+    }
+  };
+};
+
+#endif
@@ -1,13 +1,257 @@
 #include <Path2D.h>
 
+#include <Tessellator.h>
+
+#include <algorithm>
 #include <cmath>
+#include <vector>
 
 using namespace canvas;
+using namespace std;
+
+// upper bound for segments per curve or arc, guards against huge coordinates
+static const int max_segments = 4096;
+
+// Wang's formula: a degree d curve split into n uniform parameter steps
+// stays within tolerance if n >= sqrt(d(d-1)/8 * max|second difference| / tolerance)
+static inline int getNumSegments(double d2, double degree_factor, double tolerance) {
+  double n = ceil(sqrt(degree_factor * d2 / tolerance));
+  return n < 1 ? 1 : (n > max_segments ? max_segments : int(n));
+}
+
+static inline double length(double x, double y) {
+  return sqrt(x * x + y * y);
+}
+
+double
+PathComponent::getArcSpan(double sa, double ea, bool anticlockwise) {
+  double span = ea - sa;
+  if (!anticlockwise) {
+    if (span >= 2 * M_PI) return 2 * M_PI;
+    span = fmod(span, 2 * M_PI);
+    if (span < 0) span += 2 * M_PI;
+  } else {
+    if (span <= -2 * M_PI) return -2 * M_PI;
+    span = fmod(span, 2 * M_PI);
+    if (span > 0) span -= 2 * M_PI;
+  }
+  return span;
+}
+
+void
+Path2D::ellipse(const Point & p, double radius_x, double radius_y, double rotation, double sa, double ea, bool anticlockwise) {
+  addVerb(PathComponent::ARC, p);
+  if (verbs.size() == 1) subpath_start = PathComponent::getEllipsePoint(p, radius_x, radius_y, rotation, sa);
+  arcs.push_back(ArcParameters { radius_x, sa, ea, anticlockwise, radius_y, rotation });
+  extendEllipse(p, radius_x, radius_y, rotation, sa, ea, anticlockwise);
+  current_point = PathComponent::getEllipsePoint(p, radius_x, radius_y, rotation, ea);
+}
+
+void
+Path2D::roundRect(const Point & p, double w, double h, double radius, const Matrix & m) {
+  double x = w < 0 ? p.x + w : p.x, y = h < 0 ? p.y + h : p.y;
+  w = fabs(w);
+  h = fabs(h);
+  double r = std::max(0.0, std::min(radius, std::min(w, h) / 2));
+  // radii are kept as they are, as in GraphicsState::arc
+  auto corner = [&](double cx, double cy, double sa) {
+    arc(m.multiply(cx, cy), r, m.transformAngle(sa), m.transformAngle(sa + M_PI_2), false);
+  };
+  moveTo(m.multiply(x + r, y));
+  lineTo(m.multiply(x + w - r, y));
+  corner(x + w - r, y + r, -M_PI_2);
+  lineTo(m.multiply(x + w, y + h - r));
+  corner(x + w - r, y + h - r, 0);
+  lineTo(m.multiply(x + r, y + h));
+  corner(x + r, y + h - r, M_PI_2);
+  lineTo(m.multiply(x, y + r));
+  corner(x + r, y + r, M_PI);
+  closePath();
+}
+
+bool
+Path2D::isEllipse(double & cx, double & cy, double & rx, double & ry) const {
+  // [MOVE_TO at the start point] ARC [CLOSE]
+  size_t i = 0, n = verbs.size();
+  if (n && verbs[n - 1] == PathComponent::CLOSE) n--;
+  if (n == 2 && verbs[0] == PathComponent::MOVE_TO) i = 1;
+  if (n != i + 1 || verbs[i] != PathComponent::ARC) return false;
+  auto & a = arcs[0];
+  // the rotation of a circle only moves its start point
+  if ((a.rotation != 0 && a.radius != a.radius_y) || fabs(PathComponent::getArcSpan(a.sa, a.ea, a.anticlockwise)) < 2 * M_PI) return false;
+  cx = points[2 * i];
+  cy = points[2 * i + 1];
+  rx = a.radius;
+  ry = a.radius_y;
+  if (i == 1) {
+    Point s = PathComponent::getEllipsePoint(Point(cx, cy), rx, ry, a.rotation, a.sa);
+    if (fabs(s.x - points[0]) > 1e-3 || fabs(s.y - points[1]) > 1e-3) return false;
+  }
+  return true;
+}
+
+bool
+Path2D::isRoundRect(double & x0, double & y0, double & x1, double & y1, double & radius) const {
+  static const unsigned char pattern[] = {
+    PathComponent::MOVE_TO,
+    PathComponent::LINE_TO, PathComponent::ARC, PathComponent::LINE_TO, PathComponent::ARC,
+    PathComponent::LINE_TO, PathComponent::ARC, PathComponent::LINE_TO, PathComponent::ARC,
+    PathComponent::CLOSE
+  };
+  if (verbs.size() != sizeof(pattern) || !std::equal(verbs.begin(), verbs.end(), pattern)) return false;
+  radius = arcs[0].radius;
+  for (int i = 0; i < 4; i++) {
+    auto & a = arcs[i];
+    if (a.radius != radius || a.radius_y != radius || a.rotation != 0 || a.anticlockwise) return false;
+    if (fabs(a.sa - (i - 1) * M_PI_2) > 1e-6 || fabs(a.ea - i * M_PI_2) > 1e-6) return false;
+  }
+  // arc centers, as points 2, 4, 6 and 8, sit at the inner corners
+  const float * c = &points[0];
+  x0 = c[16] - radius;
+  y0 = c[5] - radius;
+  x1 = c[4] + radius;
+  y1 = c[9] + radius;
+  const float eps = 1e-3f;
+  return fabs(c[4] - c[8]) < eps && fabs(c[12] - c[16]) < eps && fabs(c[5] - c[17]) < eps && fabs(c[9] - c[13]) < eps &&
+    fabs(c[0] - (x0 + radius)) < eps && fabs(c[1] - y0) < eps;
+}
+
+void
+Path2D::lineTo(const float * xy, size_t count, const Matrix & m) {
+  if (!count) return;
+  fill_mesh.reset();
+  size_t first = points.size();
+  bool was_empty = verbs.empty();
+  verbs.insert(verbs.end(), count, PathComponent::LINE_TO);
+  points.resize(first + 2 * count);
+  float * out = &points[first];
+  m.multiply(xy, out, count);
+  for (size_t i = 0; i < count; i++) {
+    extend(Point(out[2 * i], out[2 * i + 1]));
+  }
+  current_point = Point(out[2 * count - 2], out[2 * count - 1]);
+  if (was_empty) subpath_start = Point(out[0], out[1]);
+}
+
+void
+Path2D::transform(const Matrix & m) {
+  if (m.getType() == Matrix::IDENTITY) return;
+  invalidateMeshes();
+  if (!points.empty()) m.multiply(&points[0], &points[0], points.size() / 2);
+  for (auto & a : arcs) {
+    if (a.radius != a.radius_y || a.rotation != 0) {
+      // the angles are relative to the ellipse's own axes
+      a.rotation = m.transformAngle(a.rotation);
+      continue;
+    }
+    double span = a.ea - a.sa;
+    a.sa = m.transformAngle(a.sa);
+    a.ea = fabs(span) >= 2 * M_PI ? a.sa + (span > 0 ? 2 * M_PI : -2 * M_PI) : m.transformAngle(a.ea);
+  }
+  current_point = m.multiply(current_point);
+  subpath_start = m.multiply(subpath_start);
+  updateBounds();
+}
 
 void
-Path2D::arc(const Point & p, double radius, double sa, double ea, bool anticlockwise) {
-  data.push_back(PathComponent(PathComponent::ARC, p.x, p.y, radius, sa, ea, anticlockwise));
-  current_point = Point(p.x + radius * cos(ea), p.y + radius * sin(ea));
+Path2D::updateBounds() {
+  has_bounds = false;
+  // p0 follows the current point, including the return to the subpath
+  // start on close
+  Point p0(0, 0), start(0, 0);
+  bool has_start = false;
+  for (auto pc : *this) {
+    if (!has_start || pc.type == PathComponent::MOVE_TO) {
+      start = pc.type == PathComponent::ARC ? pc.getArcPoint(pc.sa) : Point(pc.x0, pc.y0);
+      has_start = true;
+    }
+    switch (pc.type) {
+    case PathComponent::MOVE_TO:
+    case PathComponent::LINE_TO:
+      extend(Point(pc.x0, pc.y0));
+      break;
+    case PathComponent::QUADRATIC_TO:
+      extendQuadratic(p0, Point(pc.cx0, pc.cy0), Point(pc.x0, pc.y0));
+      break;
+    case PathComponent::CUBIC_TO:
+      extendCubic(p0, Point(pc.cx0, pc.cy0), Point(pc.cx1, pc.cy1), Point(pc.x0, pc.y0));
+      break;
+    case PathComponent::ARC:
+      extendEllipse(Point(pc.x0, pc.y0), pc.radius, pc.radius_y, pc.rotation, pc.sa, pc.ea, pc.anticlockwise);
+      p0 = pc.getArcPoint(pc.ea);
+      continue;
+    case PathComponent::CLOSE:
+      p0 = start;
+      continue;
+    }
+    p0 = Point(pc.x0, pc.y0);
+  }
+}
+
+void
+Path2D::extendEllipse(const Point & p, double rx, double ry, double rotation, double sa, double ea, bool anticlockwise) {
+  // the end points, plus the horizontal and vertical extrema within the sweep
+  double span = PathComponent::getArcSpan(sa, ea, anticlockwise);
+  double a0 = span >= 0 ? sa : sa + span, a1 = a0 + fabs(span);
+  extend(PathComponent::getEllipsePoint(p, rx, ry, rotation, a0));
+  extend(PathComponent::getEllipsePoint(p, rx, ry, rotation, a1));
+  double cr = cos(rotation), sr = sin(rotation);
+  double tx = atan2(-ry * sr, rx * cr), ty = atan2(ry * cr, rx * sr);
+  double candidates[] = { tx, tx + M_PI, ty, ty + M_PI };
+  for (double t : candidates) {
+    double a = fmod(t - a0, 2 * M_PI);
+    if (a < 0) a += 2 * M_PI;
+    if (a0 + a <= a1) extend(PathComponent::getEllipsePoint(p, rx, ry, rotation, a0 + a));
+  }
+}
+
+// Solves a * t^2 + b * t + c = 0 and returns the roots inside (0, 1)
+static inline int getUnitRoots(double a, double b, double c, double * roots) {
+  int n = 0;
+  if (fabs(a) < 1e-12) {
+    if (b != 0) roots[n++] = -c / b;
+  } else {
+    double d = b * b - 4 * a * c;
+    if (d >= 0) {
+      double q = sqrt(d);
+      roots[n++] = (-b + q) / (2 * a);
+      roots[n++] = (-b - q) / (2 * a);
+    }
+  }
+  int r = 0;
+  for (int i = 0; i < n; i++) {
+    if (roots[i] > 0 && roots[i] < 1) roots[r++] = roots[i];
+  }
+  return r;
+}
+
+void
+Path2D::extendQuadratic(const Point & p0, const Point & cp, const Point & p) {
+  extend(p);
+  // derivative is linear: t = (p0 - cp) / (p0 - 2 cp + p) per axis
+  double ts[2];
+  int n = 0;
+  n += getUnitRoots(0, 2 * (p0.x - 2 * cp.x + p.x), 2 * (cp.x - p0.x), ts + n);
+  n += getUnitRoots(0, 2 * (p0.y - 2 * cp.y + p.y), 2 * (cp.y - p0.y), ts + n);
+  for (int i = 0; i < n; i++) {
+    double t = ts[i], mt = 1 - t;
+    extend(Point(mt * mt * p0.x + 2 * mt * t * cp.x + t * t * p.x, mt * mt * p0.y + 2 * mt * t * cp.y + t * t * p.y));
+  }
+}
+
+void
+Path2D::extendCubic(const Point & p0, const Point & cp1, const Point & cp2, const Point & p) {
+  extend(p);
+  // derivative / 3 = a t^2 + b t + c per axis
+  double ts[4];
+  int n = 0;
+  n += getUnitRoots(-p0.x + 3 * cp1.x - 3 * cp2.x + p.x, 2 * (p0.x - 2 * cp1.x + cp2.x), cp1.x - p0.x, ts + n);
+  n += getUnitRoots(-p0.y + 3 * cp1.y - 3 * cp2.y + p.y, 2 * (p0.y - 2 * cp1.y + cp2.y), cp1.y - p0.y, ts + n);
+  for (int i = 0; i < n; i++) {
+    double t = ts[i], mt = 1 - t;
+    double a = mt * mt * mt, b = 3 * mt * mt * t, c = 3 * mt * t * t, d = t * t * t;
+    extend(Point(a * p0.x + b * cp1.x + c * cp2.x + d * p.x, a * p0.y + b * cp1.y + c * cp2.y + d * p.y));
+  }
 }
 
 // Implementation by node-canvas (Node canvas is a Cairo backed Canvas implementation for NodeJS)
@@ -84,54 +328,438 @@ Path2D::arcTo(const Point & p1, const Point & p2, double radius) {
   // current_point = p2;
 }
 
-static inline float determinant(float x1, float y1, float x2, float y2) {
-  return x1 * y2 - x2 * y1;
+Path2D
+Path2D::flatten(double tolerance) const {
+  Path2D r;
+  r.reserve(verbs.size());
+  bool has_subpath = false;
+  Point p0(0, 0);
+
+  for (auto pc : *this) {
+    switch (pc.type) {
+    case PathComponent::MOVE_TO:
+      r.moveTo(Point(pc.x0, pc.y0));
+      has_subpath = true;
+      break;
+    case PathComponent::LINE_TO:
+      r.lineTo(Point(pc.x0, pc.y0));
+      has_subpath = true;
+      break;
+    case PathComponent::CLOSE:
+      r.closePath();
+      break;
+    case PathComponent::QUADRATIC_TO: {
+      double ddx = p0.x - 2 * pc.cx0 + pc.x0, ddy = p0.y - 2 * pc.cy0 + pc.y0;
+      int n = getNumSegments(length(ddx, ddy), 2.0 / 8.0, tolerance);
+      for (int i = 1; i < n; i++) {
+	double t = double(i) / n, mt = 1 - t;
+	double a = mt * mt, b = 2 * mt * t, c = t * t;
+	r.lineTo(Point(a * p0.x + b * pc.cx0 + c * pc.x0, a * p0.y + b * pc.cy0 + c * pc.y0));
+      }
+      r.lineTo(Point(pc.x0, pc.y0));
+      has_subpath = true;
+    }
+      break;
+    case PathComponent::CUBIC_TO: {
+      double d1 = length(p0.x - 2 * pc.cx0 + pc.cx1, p0.y - 2 * pc.cy0 + pc.cy1);
+      double d2 = length(pc.cx0 - 2 * pc.cx1 + pc.x0, pc.cy0 - 2 * pc.cy1 + pc.y0);
+      int n = getNumSegments(std::max(d1, d2), 6.0 / 8.0, tolerance);
+      for (int i = 1; i < n; i++) {
+	double t = double(i) / n, mt = 1 - t;
+	double a = mt * mt * mt, b = 3 * mt * mt * t, c = 3 * mt * t * t, d = t * t * t;
+	r.lineTo(Point(a * p0.x + b * pc.cx0 + c * pc.cx1 + d * pc.x0,
+		       a * p0.y + b * pc.cy0 + c * pc.cy1 + d * pc.y0));
+      }
+      r.lineTo(Point(pc.x0, pc.y0));
+      has_subpath = true;
+    }
+      break;
+    case PathComponent::ARC: {
+      double span = PathComponent::getArcSpan(pc.sa, pc.ea, pc.anticlockwise);
+      // the angle step whose chord deviates from the circle by tolerance,
+      // using the larger radius of an ellipse
+      double radius = std::max(pc.radius, pc.radius_y);
+      int n = 1;
+      if (radius > tolerance) {
+	double step = 2 * acos(1 - tolerance / radius);
+	n = std::min(max_segments, std::max(1, int(ceil(fabs(span) / step))));
+      }
+      for (int i = 0; i <= n; i++) {
+	Point p = pc.getArcPoint(pc.sa + span * i / n);
+	if (i == 0 && !has_subpath) r.moveTo(p);
+	else r.lineTo(p);
+      }
+      has_subpath = true;
+    }
+      break;
+    }
+    p0 = r.getCurrentPoint();
+  }
+  return r;
 }
 
-#if 0
-// returns vector cross product of vectors p1p2 and p1p3 using Cramer's rule
-static inline float crossProduct(const glm::vec2 & p1, const glm::vec2 & p2, const glm::vec2 & p3) {
-  float det_p2p3 = determinant(p2.x, p2.y, p3.x, p3.y);
-  float det_p1p3 = determinant(p1.x, p1.y, p3.x, p3.y);
-  float det_p1p2 = determinant(p1.x, p1.y, p2.x, p2.y);
-  return det_p2p3 - det_p1p3 + det_p1p2;
+bool
+Path2D::isFlat() const {
+  for (auto v : verbs) {
+    if (v != PathComponent::MOVE_TO && v != PathComponent::LINE_TO && v != PathComponent::CLOSE) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// > 0 if (x, y) is left of the edge (x0, y0) -> (x1, y1), < 0 if right
+static inline double isLeft(double x0, double y0, double x1, double y1, double x, double y) {
+  return (x1 - x0) * (y - y0) - (x - x0) * (y1 - y0);
 }
 
 // The winding number method has been used here. It counts the number
 // of times a polygon winds around the point.  If the result is 0, the
 // points is outside the polygon.
 bool
-Path2D::isInside(float x, float y) const {
-  glm::vec2 point(x, y);
+Path2D::isInside(double x, double y, FillRule rule, double tolerance) const {
+  if (!has_bounds || x < bounds_min.x || x > bounds_max.x || y < bounds_min.y || y > bounds_max.y) {
+    return false;
+  }
+  if (!isFlat()) {
+    return flatten(tolerance).isInside(x, y, rule, tolerance);
+  }
+  
   int wn = 0;
-  for (unsigned int i = 0; i < data.size(); i++) {
-    glm::vec2 v1;
-    if (i == 0) {
-      v1 = glm::vec2( (float)data.back().x0, (float)data.back().y0 );	  
+  auto edge = [&](double x0, double y0, double x1, double y1) {
+    if (y0 <= y) { // start y <= P.y
+      if (y1 > y && isLeft(x0, y0, x1, y1, x, y) > 0) {
+	wn++; // an upward crossing with the point left of edge
+      }
+    } else if (y1 <= y && isLeft(x0, y0, x1, y1, x, y) < 0) {
+      wn--; // a downward crossing with the point right of edge
+    }
+  };
+
+  double start_x = 0, start_y = 0, prev_x = 0, prev_y = 0;
+  size_t point = 0;
+  for (auto v : verbs) {
+    if (v == PathComponent::CLOSE) {
+      edge(prev_x, prev_y, start_x, start_y);
+      prev_x = start_x;
+      prev_y = start_y;
+      continue;
+    }
+    double px = points[2 * point], py = points[2 * point + 1];
+    // a path that starts with a line starts a subpath there
+    if (v == PathComponent::MOVE_TO || point == 0) {
+      edge(prev_x, prev_y, start_x, start_y);
+      start_x = px;
+      start_y = py;
     } else {
-      v1 = glm::vec2( (float)data[i - 1].x0, (float)data[i - 1].y0 );	  
-    }
-    glm::vec2 v2( (float)data[i].x0, (float)data[i].y0 );
-    if (v1.y <= point.y) { // start y <= P.y
-      if (v2.y > point.y) { // an upward crossing
-	if (crossProduct(v1, v2, point) > 0) {
-	  // point left of edge
-	  wn++; // have a valid up intersect
+      edge(prev_x, prev_y, px, py);
+    }
+    prev_x = px;
+    prev_y = py;
+    point++;
+  }
+  edge(prev_x, prev_y, start_x, start_y);
+  
+  return rule == EVENODD ? (wn & 1) != 0 : wn != 0;
+}
+
+namespace {
+  // Streaming Reumann-Witkam reduction: points are dropped while they lie
+  // within tolerance of the line from the last emitted point through the
+  // first point beyond tolerance, and keep moving forward along it
+  class PolylineSimplifier {
+  public:
+    PolylineSimplifier(Path2D & _output, double _tolerance)
+      : output(_output), tolerance(_tolerance / 2) { }
+
+    void begin(const Point & p) {
+      output.moveTo(p);
+      anchor = candidate = p;
+      has_candidate = has_direction = false;
+    }
+    void add(const Point & p) {
+      if (has_direction) {
+	double dx = direction.x - anchor.x, dy = direction.y - anchor.y;
+	double len = sqrt(dx * dx + dy * dy);
+	double qx = p.x - anchor.x, qy = p.y - anchor.y;
+	double t = (qx * dx + qy * dy) / len, d = fabs(qx * dy - qy * dx) / len;
+	if (d <= tolerance && t >= max_t - tolerance) {
+	  candidate = p;
+	  if (t > max_t) max_t = t;
+	  return;
 	}
+	output.lineTo(candidate);
+	anchor = candidate;
+	has_direction = false;
+      }
+      double dx = p.x - anchor.x, dy = p.y - anchor.y;
+      candidate = p;
+      has_candidate = true;
+      if (dx * dx + dy * dy > tolerance * tolerance) {
+	direction = p;
+	max_t = sqrt(dx * dx + dy * dy);
+	has_direction = true;
+      }
+    }
+    void end(bool closed) {
+      if (has_candidate) output.lineTo(candidate);
+      if (closed) output.closePath();
+      has_candidate = has_direction = false;
+    }
+    
+  private:
+    Path2D & output;
+    double tolerance;
+    Point anchor, candidate, direction;
+    double max_t = 0;
+    bool has_candidate = false, has_direction = false;
+  };
+
+  struct ClipBox {
+    double min_x, min_y, max_x, max_y;
+  };
+
+  // box edges for Sutherland-Hodgman: 0 = left, 1 = right, 2 = top, 3 = bottom
+  inline bool isInsideEdge(const ClipBox & box, int edge, const Point & p) {
+    switch (edge) {
+    case 0: return p.x >= box.min_x;
+    case 1: return p.x <= box.max_x;
+    case 2: return p.y >= box.min_y;
+    default: return p.y <= box.max_y;
+    }
+  }
+
+  inline Point intersectEdge(const ClipBox & box, int edge, const Point & a, const Point & b) {
+    double t;
+    switch (edge) {
+    case 0: t = (box.min_x - a.x) / (b.x - a.x); break;
+    case 1: t = (box.max_x - a.x) / (b.x - a.x); break;
+    case 2: t = (box.min_y - a.y) / (b.y - a.y); break;
+    default: t = (box.max_y - a.y) / (b.y - a.y); break;
+    }
+    Point p(a.x + t * (b.x - a.x), a.y + t * (b.y - a.y));
+    // snap onto the edge so that runs along it stay exactly collinear
+    if (edge == 0) p.x = box.min_x;
+    else if (edge == 1) p.x = box.max_x;
+    else if (edge == 2) p.y = box.min_y;
+    else p.y = box.max_y;
+    return p;
+  }
+
+  void clipPolygon(const ClipBox & box, std::vector<Point> & polygon, std::vector<Point> & tmp) {
+    for (int edge = 0; edge < 4 && !polygon.empty(); edge++) {
+      tmp.clear();
+      Point prev = polygon.back();
+      bool prev_inside = isInsideEdge(box, edge, prev);
+      for (auto & p : polygon) {
+	bool inside = isInsideEdge(box, edge, p);
+	if (inside != prev_inside) tmp.push_back(intersectEdge(box, edge, prev, p));
+	if (inside) tmp.push_back(p);
+	prev = p;
+	prev_inside = inside;
       }
-    } else { // start y > P.y (no test needed)
-      if (v2.y <= point.y) { // a downward crossing
-	if (crossProduct(v1, v2, point) < 0) {
-	  // point right of edge
-	  wn--; // have a valid down intersect
+      polygon.swap(tmp);
+    }
+  }
+
+  // M4 decimation: each run of consecutive vertices in the same column
+  // keeps its first, lowest, highest and last vertex in their original
+  // order. Dropped vertices stay within one column of the outline.
+  void decimateColumns(std::vector<Point> & polyline, double column_width, std::vector<Point> & tmp) {
+    tmp.clear();
+    size_t i = 0, n = polyline.size();
+    while (i < n) {
+      double column = floor(polyline[i].x / column_width);
+      size_t first = i, lowest = i, highest = i, last = i;
+      for (i++; i < n && floor(polyline[i].x / column_width) == column; i++) {
+	if (polyline[i].y < polyline[lowest].y) lowest = i;
+	if (polyline[i].y > polyline[highest].y) highest = i;
+	last = i;
+      }
+      size_t a = std::min(lowest, highest), b = std::max(lowest, highest);
+      tmp.push_back(polyline[first]);
+      if (a != first) tmp.push_back(polyline[a]);
+      if (b != a && b != last) tmp.push_back(polyline[b]);
+      if (last != first && last != a) tmp.push_back(polyline[last]);
+    }
+    polyline.swap(tmp);
+  }
+
+  // Liang-Barsky: clips the segment a-b to the box, returns false if it misses
+  bool clipSegment(const ClipBox & box, Point & a, Point & b) {
+    double t0 = 0, t1 = 1, dx = b.x - a.x, dy = b.y - a.y;
+    double p[4] = { -dx, dx, -dy, dy };
+    double q[4] = { a.x - box.min_x, box.max_x - a.x, a.y - box.min_y, box.max_y - a.y };
+    for (int i = 0; i < 4; i++) {
+      if (p[i] == 0) {
+	if (q[i] < 0) return false;
+      } else {
+	double t = q[i] / p[i];
+	if (p[i] < 0) {
+	  if (t > t1) return false;
+	  if (t > t0) t0 = t;
+	} else {
+	  if (t < t0) return false;
+	  if (t < t1) t1 = t;
 	}
       }
     }
+    Point a0 = a;
+    if (t1 < 1) b = Point(a0.x + t1 * dx, a0.y + t1 * dy);
+    if (t0 > 0) a = Point(a0.x + t0 * dx, a0.y + t0 * dy);
+    return true;
+  }
+};
+
+Path2D
+Path2D::simplify(double tolerance, double min_x, double min_y, double max_x, double max_y, bool fill, double column_width) const {
+  if (!isFlat()) return flatten(tolerance).simplify(tolerance, min_x, min_y, max_x, max_y, fill, column_width);
+
+  Path2D r;
+  PolylineSimplifier simplifier(r, tolerance);
+  ClipBox box { min_x, min_y, max_x, max_y };
+  std::vector<Point> subpath, tmp;
+
+  auto emit = [&](bool closed) {
+    if (subpath.empty()) return;
+    if (column_width > 0) decimateColumns(subpath, column_width, tmp);
+    // index of the first vertex outside the box
+    size_t outside = 0;
+    for (; outside < subpath.size(); outside++) {
+      const Point & p = subpath[outside];
+      if (p.x < min_x || p.x > max_x || p.y < min_y || p.y > max_y) break;
+    }
+    if (outside == subpath.size()) {
+      simplifier.begin(subpath[0]);
+      for (size_t i = 1; i < subpath.size(); i++) simplifier.add(subpath[i]);
+      simplifier.end(closed);
+    } else if (fill) {
+      clipPolygon(box, subpath, tmp);
+      if (subpath.size() >= 3) {
+	simplifier.begin(subpath[0]);
+	for (size_t i = 1; i < subpath.size(); i++) simplifier.add(subpath[i]);
+	simplifier.end(true);
+      }
+    } else {
+      // visible pieces of the stroke become separate open subpaths. A
+      // closed ring is reopened at a vertex outside the box, so that the
+      // visible corners keep their joins.
+      if (closed) {
+	std::rotate(subpath.begin(), subpath.begin() + outside, subpath.end());
+	subpath.push_back(subpath[0]);
+      }
+      bool open = false;
+      for (size_t i = 0; i + 1 < subpath.size(); i++) {
+	Point a = subpath[i], b = subpath[i + 1];
+	if (!clipSegment(box, a, b)) {
+	  if (open) simplifier.end(false);
+	  open = false;
+	  continue;
+	}
+	if (!open) {
+	  simplifier.begin(a);
+	  open = true;
+	}
+	simplifier.add(b);
+	if (b.x != subpath[i + 1].x || b.y != subpath[i + 1].y) {
+	  simplifier.end(false);
+	  open = false;
+	}
+      }
+      if (open) simplifier.end(false);
+    }
+    subpath.clear();
+  };
+
+  Point start(0, 0);
+  bool first = true;
+  for (auto pc : *this) {
+    switch (pc.type) {
+    case PathComponent::MOVE_TO:
+      emit(false);
+      subpath.push_back(start = Point(pc.x0, pc.y0));
+      break;
+    case PathComponent::CLOSE:
+      emit(true);
+      break;
+    default:
+      // a segment after a close starts from the closed subpath's start,
+      // and a path that starts with a line starts a subpath there
+      if (subpath.empty() && !first) subpath.push_back(start);
+      subpath.push_back(Point(pc.x0, pc.y0));
+      if (first) start = subpath[0];
+      break;
+    }
+    first = false;
+  }
+  emit(false);
+  return r;
+}
+
+shared_ptr<const TriangleMesh>
+Path2D::getFillMesh(FillRule rule, double tolerance) const {
+  auto cached = fill_mesh;
+  if (cached && cached->rule == rule && cached->tolerance == tolerance) {
+    return cached->mesh;
+  }
+  auto mesh = make_shared<TriangleMesh>();
+  if (isFlat()) Tessellator::fill(*this, rule, *mesh);
+  else Tessellator::fill(flatten(tolerance), rule, *mesh);
+  fill_mesh = make_shared<FillMesh>(FillMesh { mesh, rule, tolerance });
+  return mesh;
+}
+
+shared_ptr<const TriangleMesh>
+Path2D::getStrokeMesh(double line_width, double tolerance) const {
+  auto cached = stroke_mesh;
+  if (cached && (cached->line_width != line_width || cached->tolerance != tolerance)) {
+    cached.reset();
+  }
+  if (cached && cached->num_verbs == verbs.size()) {
+    return cached->mesh;
   }
   
-  bool is_inside = wn != 0 ? true : false;
+  // keep everything before the last stroked subpath
+  StrokeMesh r { make_shared<TriangleMesh>(), line_width, tolerance, 0, 0, 0, 0, 0, 0 };
+  auto mesh = std::const_pointer_cast<TriangleMesh>(r.mesh);
+  if (cached) {
+    r = *cached;
+    r.mesh = mesh;
+    auto & old = *cached->mesh;
+    mesh->vertices.assign(old.vertices.begin(), old.vertices.begin() + 2 * cached->resume_vertices);
+    mesh->indices.assign(old.indices.begin(), old.indices.begin() + cached->resume_indices);
+  }
+
+  // stroke each remaining subpath (split at moves) on its own
+  size_t v = r.resume_verb, point = r.resume_point, arc = r.resume_arc;
+  while (v < verbs.size()) {
+    r.resume_verb = v;
+    r.resume_point = point;
+    r.resume_arc = arc;
+    r.resume_vertices = mesh->getNumVertices();
+    r.resume_indices = mesh->indices.size();
+    
+    Path2D subpath;
+    const_iterator it(this, v, point, arc), end = this->end();
+    for (bool first = true; it != end; ++it, first = false) {
+      auto pc = *it;
+      if (pc.type == PathComponent::MOVE_TO && !first) break;
+      switch (pc.type) {
+      case PathComponent::MOVE_TO: subpath.moveTo(Point(pc.x0, pc.y0)); break;
+      case PathComponent::LINE_TO: subpath.lineTo(Point(pc.x0, pc.y0)); break;
+      case PathComponent::QUADRATIC_TO: subpath.quadraticCurveTo(Point(pc.cx0, pc.cy0), Point(pc.x0, pc.y0)); break;
+      case PathComponent::CUBIC_TO: subpath.bezierCurveTo(Point(pc.cx0, pc.cy0), Point(pc.cx1, pc.cy1), Point(pc.x0, pc.y0)); break;
+      case PathComponent::ARC: subpath.ellipse(Point(pc.x0, pc.y0), pc.radius, pc.radius_y, pc.rotation, pc.sa, pc.ea, pc.anticlockwise); break;
+      case PathComponent::CLOSE: subpath.closePath(); break;
+      }
+      point += PathComponent::getNumPoints(pc.type);
+      if (pc.type == PathComponent::ARC) arc++;
+      v++;
+    }
+    Tessellator::stroke(subpath.isFlat() ? subpath : subpath.flatten(tolerance), line_width, tolerance, *mesh);
+  }
   
-  // fprintf(stderr, "inside test for polygon %Ld: %s\n", id, is_inside ? "true" : "false" );
-  return is_inside;
+  r.num_verbs = verbs.size();
+  stroke_mesh = make_shared<StrokeMesh>(r);
+  return mesh;
 }
-#endif
@@ -0,0 +1,137 @@
+#include <PixelBuffer.h>
+
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+using namespace std;
+using namespace canvas;
+
+static const size_t huge_page_size = 2 * 1024 * 1024;
+
+static unsigned char * allocateAligned(size_t size, size_t alignment) {
+#ifdef _WIN32
+  return (unsigned char *)_aligned_malloc(size, alignment);
+#else
+  void * ptr = 0;
+  return posix_memalign(&ptr, alignment, size) == 0 ? (unsigned char *)ptr : 0;
+#endif
+}
+
+static void freeAligned(unsigned char * ptr) {
+#ifdef _WIN32
+  _aligned_free(ptr);
+#else
+  free(ptr);
+#endif
+}
+
+PixelBufferPool &
+PixelBufferPool::getInstance() {
+  // never destroyed, so that buffers in static objects can still be released
+  static PixelBufferPool * pool = new PixelBufferPool;
+  return *pool;
+}
+
+size_t
+PixelBufferPool::getSizeClass(size_t size) {
+  if (size <= alignment) return alignment;
+  size_t p = alignment;
+  while (p * 2 < size) p *= 2;
+  size_t step = p / 4;
+  return (size + step - 1) / step * step;
+}
+
+PixelBuffer
+PixelBufferPool::allocate(size_t size) {
+  size_t size_class = getSizeClass(size);
+  unsigned char * ptr = 0;
+  bool use_huge_pages;
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    use_huge_pages = huge_page_threshold && size_class >= huge_page_threshold;
+    auto it = free_buffers.find(size_class);
+    if (it != free_buffers.end() && !it->second.empty()) {
+      ptr = it->second.back();
+      it->second.pop_back();
+      stats.pooled_bytes -= size_class;
+      stats.reuses++;
+    }
+    stats.allocations++;
+    stats.live_bytes += size_class;
+    if (stats.live_bytes > stats.peak_bytes) stats.peak_bytes = stats.live_bytes;
+  }
+  if (!ptr) {
+    ptr = allocateAligned(size_class, use_huge_pages ? huge_page_size : alignment);
+    if (!ptr) {
+      std::lock_guard<std::mutex> guard(mutex);
+      stats.live_bytes -= size_class;
+      throw std::bad_alloc();
+    }
+#ifdef MADV_HUGEPAGE
+    if (use_huge_pages) madvise(ptr, size_class, MADV_HUGEPAGE);
+#endif
+  }
+  return PixelBuffer(ptr, [this, size_class](unsigned char * p) { release(p, size_class); });
+}
+
+void
+PixelBufferPool::release(unsigned char * ptr, size_t size_class) {
+  if (!ptr) return;
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    stats.live_bytes -= size_class;
+    if (stats.pooled_bytes + size_class <= max_pooled_bytes) {
+      free_buffers[size_class].push_back(ptr);
+      stats.pooled_bytes += size_class;
+      return;
+    }
+  }
+  freeAligned(ptr);
+}
+
+void
+PixelBufferPool::trimTo(size_t max_bytes) {
+  std::vector<unsigned char *> freed;
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    for (auto it = free_buffers.begin(); it != free_buffers.end() && stats.pooled_bytes > max_bytes; it++) {
+      while (!it->second.empty() && stats.pooled_bytes > max_bytes) {
+	freed.push_back(it->second.back());
+	it->second.pop_back();
+	stats.pooled_bytes -= it->first;
+      }
+    }
+  }
+  for (auto ptr : freed) freeAligned(ptr);
+}
+
+void
+PixelBufferPool::trim() {
+  trimTo(0);
+}
+
+void
+PixelBufferPool::setMaxPooledBytes(size_t bytes) {
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    max_pooled_bytes = bytes;
+  }
+  trimTo(bytes);
+}
+
+void
+PixelBufferPool::setHugePageThreshold(size_t bytes) {
+  std::lock_guard<std::mutex> guard(mutex);
+  huge_page_threshold = bytes;
+}
+
+PixelBufferPool::Statistics
+PixelBufferPool::getStatistics() const {
+  std::lock_guard<std::mutex> guard(mutex);
+  return stats;
+}
@@ -0,0 +1,249 @@
+#include <Rasterizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace canvas;
+
+void
+Rasterizer::addEdge(double x0, double y0, double x1, double y1) {
+  if (y0 == y1) return;
+  int winding = 1;
+  if (y0 > y1) {
+    std::swap(x0, x1);
+    std::swap(y0, y1);
+    winding = -1;
+  }
+  edges.push_back(Edge { float(x0), float(y0), float(y1), float((x1 - x0) / (y1 - y0)), winding });
+}
+
+void
+Rasterizer::setPath(const Path2D & input_path, double scale, double dx, double dy) {
+  edges.clear();
+
+  // recognized shapes need no edges
+  shape = SHAPE_PATH;
+  double cx, cy, rx, ry, x0, y0, x1, y1, r;
+  if (input_path.isEllipse(cx, cy, rx, ry)) {
+    shape = SHAPE_ELLIPSE;
+    shape_rx = fabs(rx) * scale;
+    shape_ry = fabs(ry) * scale;
+    shape_x0 = cx * scale + dx - shape_rx;
+    shape_y0 = cy * scale + dy - shape_ry;
+    shape_x1 = cx * scale + dx + shape_rx;
+    shape_y1 = cy * scale + dy + shape_ry;
+  } else if (input_path.isRoundRect(x0, y0, x1, y1, r)) {
+    shape = SHAPE_ROUND_RECT;
+    shape_x0 = x0 * scale + dx;
+    shape_y0 = y0 * scale + dy;
+    shape_x1 = x1 * scale + dx;
+    shape_y1 = y1 * scale + dy;
+    shape_rx = shape_ry = r * scale;
+  }
+  // too thin for the distance approximation
+  if (shape != SHAPE_PATH && (shape_x1 - shape_x0 < 1 || shape_y1 - shape_y0 < 1)) {
+    shape = SHAPE_PATH;
+  }
+  if (shape != SHAPE_PATH) return;
+
+  Path2D flattened;
+  if (!input_path.isFlat()) flattened = input_path.flatten(0.25 / scale);
+  const Path2D & path = input_path.isFlat() ? input_path : flattened;
+
+  // every subpath is implicitly closed
+  double start_x = 0, start_y = 0, prev_x = 0, prev_y = 0;
+  bool first = true;
+  for (auto pc : path) {
+    if (pc.type == PathComponent::CLOSE) {
+      addEdge(prev_x, prev_y, start_x, start_y);
+      prev_x = start_x;
+      prev_y = start_y;
+      continue;
+    }
+    double x = pc.x0 * scale + dx, y = pc.y0 * scale + dy;
+    if (pc.type == PathComponent::MOVE_TO || first) {
+      addEdge(prev_x, prev_y, start_x, start_y);
+      start_x = x;
+      start_y = y;
+    } else {
+      addEdge(prev_x, prev_y, x, y);
+    }
+    prev_x = x;
+    prev_y = y;
+    first = false;
+  }
+  addEdge(prev_x, prev_y, start_x, start_y);
+  
+  std::sort(edges.begin(), edges.end(), [](const Edge & a, const Edge & b) { return a.y0 < b.y0; });
+}
+
+bool
+Rasterizer::getShapeSpan(double y, double & x0, double & x1) const {
+  double cx = (shape_x0 + shape_x1) / 2, cy = (shape_y0 + shape_y1) / 2;
+  double py = fabs(y - cy), half_width;
+  if (shape == SHAPE_ELLIPSE) {
+    if (py >= shape_ry) return false;
+    half_width = shape_rx * sqrt(1 - py * py / (shape_ry * shape_ry));
+  } else {
+    double r = shape_rx, hx = (shape_x1 - shape_x0) / 2, hy = (shape_y1 - shape_y0) / 2;
+    if (py >= hy) return false;
+    double qy = std::max(0.0, py - (hy - r));
+    half_width = hx - r + sqrt(std::max(0.0, r * r - qy * qy));
+  }
+  x0 = cx - half_width;
+  x1 = cx + half_width;
+  return true;
+}
+
+double
+Rasterizer::getShapeCoverage(double x, double y) const {
+  double cx = (shape_x0 + shape_x1) / 2, cy = (shape_y0 + shape_y1) / 2;
+  double px = x - cx, py = y - cy, d;
+  if (shape == SHAPE_ELLIPSE) {
+    // implicit function divided by its gradient length
+    double rx2 = shape_rx * shape_rx, ry2 = shape_ry * shape_ry;
+    double f = px * px / rx2 + py * py / ry2 - 1;
+    double gx = 2 * px / rx2, gy = 2 * py / ry2, g = sqrt(gx * gx + gy * gy);
+    d = g > 0 ? f / g : -std::min(shape_rx, shape_ry);
+  } else {
+    double r = shape_rx;
+    double qx = fabs(px) - ((shape_x1 - shape_x0) / 2 - r), qy = fabs(py) - ((shape_y1 - shape_y0) / 2 - r);
+    double ox = std::max(qx, 0.0), oy = std::max(qy, 0.0);
+    d = sqrt(ox * ox + oy * oy) + std::min(std::max(qx, qy), 0.0) - r;
+  }
+  return d <= -0.5 ? 1.0 : (d >= 0.5 ? 0.0 : 0.5 - d);
+}
+
+void
+Rasterizer::fillShape(unsigned char * mask, unsigned int width, unsigned int height, size_t stride) const {
+  int y0 = std::max(0, int(floor(shape_y0))), y1 = std::min(int(height), int(ceil(shape_y1)));
+  int x0 = std::max(0, int(floor(shape_x0))), x1 = std::min(int(width), int(ceil(shape_x1)));
+  for (int y = y0; y < y1; y++) {
+    unsigned char * row = mask + y * stride;
+    double yc = y + 0.5;
+    int left = x0, right = x1;
+    for (; left < right; left++) {
+      double c = getShapeCoverage(left + 0.5, yc);
+      row[left] = (unsigned char)(c * 255 + 0.5);
+      if (c >= 1.0) break;
+    }
+    for (; right > left; right--) {
+      double c = getShapeCoverage(right - 0.5, yc);
+      row[right - 1] = (unsigned char)(c * 255 + 0.5);
+      if (c >= 1.0) break;
+    }
+    if (right - left > 2) memset(row + left + 1, 255, right - left - 2);
+  }
+}
+
+void
+Rasterizer::scan(double y0, double step, unsigned int count, FillRule rule, const std::function<void(unsigned int, const std::vector<float> &)> & fn) const {
+  std::vector<const Edge *> active;
+  std::vector<std::pair<float, int> > crossings;
+  std::vector<float> spans;
+  size_t next_edge = 0;
+  
+  for (unsigned int i = 0; i < count; i++) {
+    float y = float(y0 + i * step);
+    while (next_edge < edges.size() && edges[next_edge].y0 <= y) {
+      active.push_back(&edges[next_edge++]);
+    }
+    active.erase(std::remove_if(active.begin(), active.end(), [y](const Edge * e) { return e->y1 <= y; }), active.end());
+    if (active.empty()) {
+      if (next_edge == edges.size()) break;
+      continue;
+    }
+
+    crossings.clear();
+    for (auto e : active) {
+      crossings.push_back(std::make_pair(e->x0 + (y - e->y0) * e->dxdy, e->winding));
+    }
+    std::sort(crossings.begin(), crossings.end());
+
+    spans.clear();
+    int winding = 0;
+    for (auto & c : crossings) {
+      bool was_inside = rule == EVENODD ? (winding & 1) != 0 : winding != 0;
+      winding += c.second;
+      bool is_inside = rule == EVENODD ? (winding & 1) != 0 : winding != 0;
+      if (is_inside != was_inside) spans.push_back(c.first);
+    }
+    if (!spans.empty()) fn(i, spans);
+  }
+}
+
+void
+Rasterizer::fill(unsigned char * mask, unsigned int width, unsigned int height, size_t stride, FillRule rule, unsigned int samples) const {
+  for (unsigned int y = 0; y < height; y++) {
+    memset(mask + y * stride, 0, width);
+  }
+  if (empty() || !width) return;
+  if (shape != SHAPE_PATH) {
+    fillShape(mask, width, height, stride);
+    return;
+  }
+
+  // partial coverage per pixel, and the change in full coverage at each pixel
+  std::vector<float> cover(width + 1), delta(width + 1);
+  unsigned int current_row = 0;
+  bool dirty = false;
+  
+  auto flush = [&]() {
+    unsigned char * row = mask + current_row * stride;
+    float full = 0, s = 255.0f / samples;
+    for (unsigned int x = 0; x < width; x++) {
+      full += delta[x];
+      float v = (full + cover[x]) * s;
+      row[x] = (unsigned char)(v >= 255.0f ? 255 : v + 0.5f);
+    }
+    std::fill(cover.begin(), cover.end(), 0.0f);
+    std::fill(delta.begin(), delta.end(), 0.0f);
+    dirty = false;
+  };
+  
+  scan(0.5 / samples, 1.0 / samples, height * samples, rule, [&](unsigned int line, const std::vector<float> & spans) {
+      unsigned int row = line / samples;
+      if (row != current_row) {
+	if (dirty) flush();
+	current_row = row;
+      }
+      for (size_t i = 0; i + 1 < spans.size(); i += 2) {
+	float x0 = std::max(0.0f, spans[i]), x1 = std::min(float(width), spans[i + 1]);
+	if (x0 >= x1) continue;
+	unsigned int i0 = (unsigned int)x0, i1 = (unsigned int)x1;
+	if (i0 == i1) {
+	  cover[i0] += x1 - x0;
+	} else {
+	  cover[i0] += i0 + 1 - x0;
+	  delta[i0 + 1] += 1.0f;
+	  delta[i1] -= 1.0f;
+	  cover[i1] += x1 - i1;
+	}
+      }
+      dirty = true;
+    });
+  if (dirty) flush();
+}
+
+void
+Rasterizer::getSpans(unsigned int width, unsigned int height, FillRule rule, const std::function<void(unsigned int, unsigned int, unsigned int)> & fn) const {
+  if (shape != SHAPE_PATH) {
+    int y0 = std::max(0, int(floor(shape_y0))), y1 = std::min(int(height), int(ceil(shape_y1)));
+    for (int y = y0; y < y1; y++) {
+      double sx0, sx1;
+      if (!getShapeSpan(y + 0.5, sx0, sx1)) continue;
+      double x0 = std::max(0.0, ceil(sx0 - 0.5)), x1 = std::min(double(width), ceil(sx1 - 0.5));
+      if (x0 < x1) fn(y, (unsigned int)x0, (unsigned int)x1);
+    }
+    return;
+  }
+  scan(0.5, 1.0, height, rule, [&](unsigned int y, const std::vector<float> & spans) {
+      for (size_t i = 0; i + 1 < spans.size(); i += 2) {
+	// first and one past the last pixel center within the span
+	float x0 = std::max(0.0f, ceilf(spans[i] - 0.5f));
+	float x1 = std::min(float(width), ceilf(spans[i + 1] - 0.5f));
+	if (x0 < x1) fn(y, (unsigned int)x0, (unsigned int)x1);
+      }
+    });
+}
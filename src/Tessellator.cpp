@@ -0,0 +1,267 @@
+#include <Tessellator.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+
+using namespace canvas;
+using namespace std;
+
+namespace {
+  struct Polyline {
+    vector<Point> points;
+    bool closed;
+  };
+
+  // Splits a flat path into subpaths with the same rules as the fill
+  void getPolylines(const Path2D & path, vector<Polyline> & polylines) {
+    Point start(0, 0);
+    bool first = true;
+    Polyline current { vector<Point>(), false };
+    auto emit = [&](bool closed) {
+      if (!current.points.empty()) {
+	current.closed = closed;
+	polylines.push_back(current);
+	current.points.clear();
+      }
+    };
+    for (auto pc : path) {
+      switch (pc.type) {
+      case PathComponent::MOVE_TO:
+	emit(false);
+	current.points.push_back(start = Point(pc.x0, pc.y0));
+	break;
+      case PathComponent::CLOSE:
+	emit(true);
+	break;
+      default:
+	// a segment after a close starts from the closed subpath's start
+	if (current.points.empty() && !first) current.points.push_back(start);
+	current.points.push_back(Point(pc.x0, pc.y0));
+	if (first) start = current.points[0];
+	break;
+      }
+      first = false;
+    }
+    emit(false);
+  }
+
+  // Adds vertices to a mesh, reusing the index of an identical vertex
+  class VertexWriter {
+  public:
+    VertexWriter(TriangleMesh & _mesh) : mesh(_mesh) { }
+
+    unsigned int add(float x, float y) {
+      uint32_t bx, by;
+      memcpy(&bx, &x, 4);
+      memcpy(&by, &y, 4);
+      uint64_t key = (uint64_t(bx) << 32) | by;
+      auto it = index.find(key);
+      if (it != index.end()) return it->second;
+      unsigned int i = (unsigned int)mesh.getNumVertices();
+      mesh.vertices.push_back(x);
+      mesh.vertices.push_back(y);
+      index[key] = i;
+      return i;
+    }
+    void addTriangle(unsigned int a, unsigned int b, unsigned int c) {
+      if (a == b || b == c || a == c) return;
+      mesh.indices.push_back(a);
+      mesh.indices.push_back(b);
+      mesh.indices.push_back(c);
+    }
+
+  private:
+    TriangleMesh & mesh;
+    unordered_map<uint64_t, unsigned int> index;
+  };
+
+  struct Edge {
+    double x0, y0, x1, y1, dxdy;
+    int winding;
+    // sweep state: x at the current height, the last neighbour tested
+    // for a crossing and the open trapezoid this edge is the left side of
+    double x;
+    const Edge * tested, * span_right;
+    double span_y;
+    unsigned int span_event;
+    double getX(double y) const { return x0 + (y - y0) * dxdy; }
+  };
+
+  // Order along the sweep line, with ties broken by the order just below
+  bool isLeftOf(const Edge * a, const Edge * b) {
+    double eps = 1e-9 * (1 + fabs(a->x));
+    if (a->x < b->x - eps) return true;
+    if (a->x > b->x + eps) return false;
+    return a->dxdy < b->dxdy;
+  }
+};
+
+void
+Tessellator::fill(const Path2D & path, FillRule rule, TriangleMesh & mesh) {
+  vector<Polyline> polylines;
+  getPolylines(path, polylines);
+
+  // every subpath is implicitly closed
+  vector<Edge> edges;
+  vector<double> ys;
+  for (auto & pl : polylines) {
+    auto & p = pl.points;
+    for (size_t i = 0; i < p.size(); i++) {
+      const Point & a = p[i], & b = p[(i + 1) % p.size()];
+      if (a.y == b.y) continue;
+      Edge e = a.y < b.y ? Edge { a.x, a.y, b.x, b.y, 0, 1 } : Edge { b.x, b.y, a.x, a.y, 0, -1 };
+      e.dxdy = (e.x1 - e.x0) / (e.y1 - e.y0);
+      e.tested = e.span_right = nullptr;
+      e.span_event = 0;
+      edges.push_back(e);
+      ys.push_back(a.y);
+    }
+  }
+  if (edges.empty()) return;
+  sort(ys.begin(), ys.end());
+  ys.erase(unique(ys.begin(), ys.end()), ys.end());
+  sort(edges.begin(), edges.end(), [](const Edge & a, const Edge & b) { return a.y0 < b.y0; });
+
+  // Sweeps downwards keeping the active edges in x order. Only adjacent
+  // edges are tested for crossings, and a trapezoid is emitted when its
+  // pair of sides stops bounding an inside span.
+  VertexWriter writer(mesh);
+  vector<Edge *> active;
+  vector<pair<Edge *, Edge *> > spans, open_spans;
+  priority_queue<double, vector<double>, greater<double> > crossings;
+  size_t next_edge = 0, next_y = 0;
+  unsigned int event = 0;
+
+  auto emit = [&](const Edge * left, const Edge * right, double y0, double y1) {
+    if (y1 <= y0) return;
+    unsigned int a = writer.add(float(left->getX(y0)), float(y0));
+    unsigned int b = writer.add(float(right->getX(y0)), float(y0));
+    unsigned int c = writer.add(float(right->getX(y1)), float(y1));
+    unsigned int d = writer.add(float(left->getX(y1)), float(y1));
+    writer.addTriangle(a, b, c);
+    writer.addTriangle(a, c, d);
+  };
+
+  while (next_y < ys.size() || !crossings.empty()) {
+    double y = next_y < ys.size() ? ys[next_y] : crossings.top();
+    if (!crossings.empty() && crossings.top() < y) y = crossings.top();
+    while (next_y < ys.size() && ys[next_y] <= y) next_y++;
+    while (!crossings.empty() && crossings.top() <= y) crossings.pop();
+    event++;
+
+    active.erase(remove_if(active.begin(), active.end(), [y](const Edge * e) { return e->y1 <= y; }), active.end());
+    while (next_edge < edges.size() && edges[next_edge].y0 <= y) {
+      active.push_back(&edges[next_edge++]);
+    }
+    // the order only changes at crossings and new edges, so insertion
+    // sort does little work
+    for (auto e : active) e->x = e->getX(y);
+    for (size_t i = 1; i < active.size(); i++) {
+      Edge * e = active[i];
+      size_t j = i;
+      for (; j > 0 && isLeftOf(e, active[j - 1]); j--) active[j] = active[j - 1];
+      active[j] = e;
+    }
+
+    // schedule the crossings of new neighbours
+    for (size_t i = 0; i + 1 < active.size(); i++) {
+      Edge * a = active[i], * b = active[i + 1];
+      if (a->tested == b) continue;
+      a->tested = b;
+      double y1 = min(a->y1, b->y1);
+      double d0 = b->x - a->x, d1 = b->getX(y1) - a->getX(y1);
+      if (d0 > 0 && d1 < 0) {
+	double yc = y + (y1 - y) * d0 / (d0 - d1);
+	if (yc > y) crossings.push(yc);
+      }
+    }
+
+    // inside spans below this height
+    spans.clear();
+    int winding = 0;
+    Edge * left = nullptr;
+    for (auto e : active) {
+      bool was_inside = rule == EVENODD ? (winding & 1) != 0 : winding != 0;
+      winding += e->winding;
+      bool is_inside = rule == EVENODD ? (winding & 1) != 0 : winding != 0;
+      if (is_inside && !was_inside) {
+	left = e;
+      } else if (!is_inside && was_inside) {
+	spans.push_back(make_pair(left, e));
+      }
+    }
+
+    // close the trapezoids whose sides changed and open the new ones
+    for (auto & s : spans) {
+      if (s.first->span_right == s.second) s.first->span_event = event;
+    }
+    for (auto & s : open_spans) {
+      if (s.first->span_event != event) {
+	emit(s.first, s.second, s.first->span_y, y);
+	s.first->span_right = nullptr;
+      }
+    }
+    for (auto & s : spans) {
+      if (s.first->span_event != event) {
+	s.first->span_right = s.second;
+	s.first->span_y = y;
+      }
+    }
+    open_spans.swap(spans);
+  }
+}
+
+void
+Tessellator::stroke(const Path2D & path, double line_width, double tolerance, TriangleMesh & mesh) {
+  double hw = line_width / 2;
+  if (hw <= 0) return;
+  // angle step of round joins with chords within tolerance
+  double step = hw > tolerance ? 2 * acos(1 - tolerance / hw) : M_PI / 2;
+  
+  vector<Polyline> polylines;
+  getPolylines(path, polylines);
+  VertexWriter writer(mesh);
+  
+  for (auto & pl : polylines) {
+    vector<Point> & p = pl.points;
+    p.erase(unique(p.begin(), p.end(), [](const Point & a, const Point & b) { return a.x == b.x && a.y == b.y; }), p.end());
+    if (pl.closed && p.size() > 1 && p.front().x == p.back().x && p.front().y == p.back().y) p.pop_back();
+    if (p.size() < 2) continue;
+    
+    size_t num_segments = pl.closed ? p.size() : p.size() - 1;
+    for (size_t i = 0; i < num_segments; i++) {
+      const Point & a = p[i], & b = p[(i + 1) % p.size()];
+      double dx = b.x - a.x, dy = b.y - a.y, len = sqrt(dx * dx + dy * dy);
+      double nx = -dy / len * hw, ny = dx / len * hw;
+      unsigned int v0 = writer.add(float(a.x + nx), float(a.y + ny));
+      unsigned int v1 = writer.add(float(a.x - nx), float(a.y - ny));
+      unsigned int v2 = writer.add(float(b.x - nx), float(b.y - ny));
+      unsigned int v3 = writer.add(float(b.x + nx), float(b.y + ny));
+      writer.addTriangle(v0, v1, v2);
+      writer.addTriangle(v0, v2, v3);
+
+      // round join towards the next segment, on the outer side of the turn
+      if (!pl.closed && i + 1 == num_segments) break;
+      const Point & c = p[(i + 2) % p.size()];
+      double ex = c.x - b.x, ey = c.y - b.y, elen = sqrt(ex * ex + ey * ey);
+      double cross = (dx * ey - dy * ex) / (len * elen), dot = (dx * ex + dy * ey) / (len * elen);
+      double angle = atan2(cross, dot);
+      if (angle == 0) continue;
+      double s = cross > 0 ? -1 : 1;
+      double sx = s * nx, sy = s * ny;
+      int n = std::max(1, int(ceil(fabs(angle) / step)));
+      unsigned int center = writer.add(float(b.x), float(b.y));
+      unsigned int prev = writer.add(float(b.x + sx), float(b.y + sy));
+      for (int k = 1; k <= n; k++) {
+	double r = angle * k / n, cr = cos(r), sr = sin(r);
+	unsigned int v = writer.add(float(b.x + sx * cr - sy * sr), float(b.y + sx * sr + sy * cr));
+	writer.addTriangle(center, prev, v);
+	prev = v;
+      }
+    }
+  }
+}
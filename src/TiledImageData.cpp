@@ -0,0 +1,188 @@
+#include <TiledImageData.h>
+#include <ParallelFor.h>
+
+#include "HalveRow.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include "stb_image_resize.h"
+
+using namespace std;
+using namespace canvas;
+
+TiledImageData::TiledImageData(unsigned int _width, unsigned int _height, unsigned short _num_channels, unsigned int _tile_size)
+  : width(_width), height(_height), num_channels(_num_channels), tile_size(_tile_size),
+    cols((_width + _tile_size - 1) / _tile_size), rows((_height + _tile_size - 1) / _tile_size)
+{
+  assert(tile_size);
+  tiles.resize(size_t(cols) * rows);
+}
+
+size_t
+TiledImageData::getNumAllocatedTiles() const {
+  size_t n = 0;
+  for (auto & t : tiles) if (t.get()) n++;
+  return n;
+}
+
+ImageDataView
+TiledImageData::getTile(unsigned int tx, unsigned int ty) const {
+  auto & tile = tiles[size_t(ty) * cols + tx];
+  if (!tile.get()) return ImageDataView();
+  return ImageDataView(tile.get(), getTileWidth(tx), getTileHeight(ty), num_channels, size_t(tile_size) * num_channels);
+}
+
+unsigned char *
+TiledImageData::getTileForWriting(unsigned int tx, unsigned int ty) {
+  auto & tile = tiles[size_t(ty) * cols + tx];
+  if (!tile.get()) {
+    size_t s = size_t(tile_size) * tile_size * num_channels;
+    tile = allocatePixelBuffer(s);
+    memset(tile.get(), 0, s);
+  }
+  return tile.get();
+}
+
+void
+TiledImageData::write(unsigned int x, unsigned int y, const ImageDataView & input) {
+  assert(input.getNumChannels() == num_channels);
+  assert(x + input.getWidth() <= width && y + input.getHeight() <= height);
+  if (!input.getWidth() || !input.getHeight()) return;
+  unsigned int x1 = x + input.getWidth(), y1 = y + input.getHeight();
+  size_t tile_stride = size_t(tile_size) * num_channels;
+  for (unsigned int ty = y / tile_size; ty * tile_size < y1; ty++) {
+    unsigned int ty0 = ty * tile_size, iy0 = max(y, ty0), iy1 = min(y1, ty0 + tile_size);
+    for (unsigned int tx = x / tile_size; tx * tile_size < x1; tx++) {
+      unsigned int tx0 = tx * tile_size, ix0 = max(x, tx0), ix1 = min(x1, tx0 + tile_size);
+      unsigned char * tile = getTileForWriting(tx, ty);
+      for (unsigned int iy = iy0; iy < iy1; iy++) {
+	memcpy(tile + (iy - ty0) * tile_stride + (ix0 - tx0) * num_channels, input.getRow(iy - y) + size_t(ix0 - x) * num_channels, (ix1 - ix0) * num_channels);
+      }
+    }
+  }
+}
+
+std::unique_ptr<ImageData>
+TiledImageData::read(unsigned int x, unsigned int y, unsigned int w, unsigned int h) const {
+  assert(x + w <= width && y + h <= height);
+  std::unique_ptr<ImageData> r(new ImageData(w, h, num_channels));
+  if (!w || !h) return r;
+  unsigned int x1 = x + w, y1 = y + h;
+  size_t tile_stride = size_t(tile_size) * num_channels, row_size = size_t(w) * num_channels;
+  for (unsigned int ty = y / tile_size; ty * tile_size < y1; ty++) {
+    unsigned int ty0 = ty * tile_size, iy0 = max(y, ty0), iy1 = min(y1, ty0 + tile_size);
+    for (unsigned int tx = x / tile_size; tx * tile_size < x1; tx++) {
+      const unsigned char * tile = tiles[size_t(ty) * cols + tx].get();
+      if (!tile) continue;
+      unsigned int tx0 = tx * tile_size, ix0 = max(x, tx0), ix1 = min(x1, tx0 + tile_size);
+      for (unsigned int iy = iy0; iy < iy1; iy++) {
+	memcpy(r->getData() + (iy - y) * row_size + size_t(ix0 - x) * num_channels, tile + (iy - ty0) * tile_stride + (ix0 - tx0) * num_channels, (ix1 - ix0) * num_channels);
+      }
+    }
+  }
+  return r;
+}
+
+bool
+TiledImageData::isRegionEmpty(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1) const {
+  for (unsigned int ty = y0 / tile_size; ty * tile_size < y1; ty++) {
+    for (unsigned int tx = x0 / tile_size; tx * tile_size < x1; tx++) {
+      if (isTileAllocated(tx, ty)) return false;
+    }
+  }
+  return true;
+}
+
+// Same 2x2 box filter and odd edge handling as ImageData::reduce,
+// applied per output tile
+std::unique_ptr<TiledImageData>
+TiledImageData::halve() const {
+  std::unique_ptr<TiledImageData> r(new TiledImageData((width + 1) / 2, (height + 1) / 2, num_channels, tile_size));
+  TiledImageData * output = r.get();
+  parallelFor(output->rows, 1, [=](unsigned int ty0, unsigned int ty1) {
+      for (unsigned int ty = ty0; ty < ty1; ty++) {
+	for (unsigned int tx = 0; tx < output->cols; tx++) {
+	  unsigned int x0 = 2 * tx * tile_size, y0 = 2 * ty * tile_size;
+	  // the last input tile is one short when the size is odd
+	  unsigned int w = min(2 * output->getTileWidth(tx), width - x0), h = min(2 * output->getTileHeight(ty), height - y0);
+	  if (isRegionEmpty(x0, y0, x0 + w, y0 + h)) continue;
+	  auto region = read(x0, y0, w, h);
+	  ImageData halved((w + 1) / 2, (h + 1) / 2, num_channels, false);
+	  halveImage(region->getData(), w, h, num_channels, halved.getData());
+	  output->write(tx * tile_size, ty * tile_size, halved);
+	}
+      }
+    });
+  return r;
+}
+
+std::unique_ptr<TiledImageData>
+TiledImageData::scale(unsigned int target_width, unsigned int target_height) const {
+  std::unique_ptr<TiledImageData> reduced;
+  const TiledImageData * input = this;
+  while (input->width >= 2 * target_width && input->height >= 2 * target_height && input->width >= 2 && input->height >= 2) {
+    reduced = input->halve();
+    input = reduced.get();
+  }
+
+  std::unique_ptr<TiledImageData> r(new TiledImageData(target_width, target_height, num_channels, tile_size));
+  TiledImageData * output = r.get();
+  if (!target_width || !target_height) return r;
+
+  double sx = double(target_width) / input->width, sy = double(target_height) / input->height;
+  // input pixels beyond the tile that the resampling filter can reach
+  unsigned int mx = (unsigned int)ceil(3.0 / min(sx, 1.0)) + 1;
+  unsigned int my = (unsigned int)ceil(3.0 / min(sy, 1.0)) + 1;
+
+  parallelFor(output->rows, 1, [=](unsigned int ty0, unsigned int ty1) {
+      for (unsigned int ty = ty0; ty < ty1; ty++) {
+	unsigned int oy0 = ty * tile_size, oh = output->getTileHeight(ty);
+	unsigned int iy0 = (unsigned int)max(0.0, floor(oy0 / sy) - my);
+	unsigned int iy1 = (unsigned int)min(double(input->height), ceil((oy0 + oh) / sy) + my);
+	for (unsigned int tx = 0; tx < output->cols; tx++) {
+	  unsigned int ox0 = tx * tile_size, ow = output->getTileWidth(tx);
+	  unsigned int ix0 = (unsigned int)max(0.0, floor(ox0 / sx) - mx);
+	  unsigned int ix1 = (unsigned int)min(double(input->width), ceil((ox0 + ow) / sx) + mx);
+	  if (input->isRegionEmpty(ix0, iy0, ix1, iy1)) continue;
+	  auto region = input->read(ix0, iy0, ix1 - ix0, iy1 - iy0);
+	  stbir_resize_subpixel(region->getData(), region->getWidth(), region->getHeight(), 0,
+				output->getTileForWriting(tx, ty), ow, oh, tile_size * num_channels,
+				STBIR_TYPE_UINT8, num_channels, STBIR_ALPHA_CHANNEL_NONE, 0,
+				STBIR_EDGE_CLAMP, STBIR_EDGE_CLAMP, STBIR_FILTER_DEFAULT, STBIR_FILTER_DEFAULT,
+				STBIR_COLORSPACE_LINEAR, NULL, float(sx), float(sy), float(ox0 - ix0 * sx), float(oy0 - iy0 * sy));
+	}
+      }
+    });
+
+  return r;
+}
+
+// Each output tile is blurred from its input tile plus the kernel radius
+// around it, which gives the same result as blurring the whole image.
+std::unique_ptr<TiledImageData>
+TiledImageData::blur(float hradius, float vradius) const {
+  std::unique_ptr<TiledImageData> r(new TiledImageData(width, height, num_channels, tile_size));
+  TiledImageData * output = r.get();
+  unsigned int mx = hradius > 0.0f ? (unsigned int)ceil(hradius) : 0;
+  unsigned int my = vradius > 0.0f ? (unsigned int)ceil(vradius) : 0;
+
+  parallelFor(rows, 1, [=](unsigned int ty0, unsigned int ty1) {
+      for (unsigned int ty = ty0; ty < ty1; ty++) {
+	unsigned int y0 = ty * tile_size, h = getTileHeight(ty);
+	unsigned int ry0 = y0 > my ? y0 - my : 0, ry1 = min(height, y0 + h + my);
+	for (unsigned int tx = 0; tx < cols; tx++) {
+	  unsigned int x0 = tx * tile_size, w = getTileWidth(tx);
+	  unsigned int rx0 = x0 > mx ? x0 - mx : 0, rx1 = min(width, x0 + w + mx);
+	  if (isRegionEmpty(rx0, ry0, rx1, ry1)) continue;
+	  auto region = read(rx0, ry0, rx1 - rx0, ry1 - ry0);
+	  auto blurred = region->blur(hradius, vradius);
+	  output->write(x0, y0, ImageDataView(*blurred).crop(x0 - rx0, y0 - ry0, w, h));
+	}
+      }
+    });
+
+  return r;
+}
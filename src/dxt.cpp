@@ -543,7 +543,8 @@ static inline void stb__CompressAlphaBlock(unsigned char *dest,unsigned char *sr
 }
 
 // Red block compression (this is easy for a change)
-static inline void stb__CompressRGTCBlock(unsigned char *dest, unsigned char *src) {
+// src holds 16 values, stride bytes apart
+static inline void stb__CompressRGTCBlock(unsigned char *dest, unsigned char *src, int stride) {
   int i,dist,bias,dist4,dist2,bits,mask;
   
   // find min/max color
@@ -551,8 +552,8 @@ static inline void stb__CompressRGTCBlock(unsigned char *dest, unsigned char *sr
   mn = mx = src[0];
   
   for (i=1;i<16;i++) {
-    if (src[i] < mn) mn = src[i];
-    else if (src[i] > mx) mx = src[i];
+    if (src[i*stride] < mn) mn = src[i*stride];
+    else if (src[i*stride] > mx) mx = src[i*stride];
   }
   
   // encode them
@@ -571,7 +572,7 @@ static inline void stb__CompressRGTCBlock(unsigned char *dest, unsigned char *sr
   bits = 0,mask=0;
   
   for (i=0;i<16;i++) {
-    int a = src[i*2+0]*7 + bias;
+    int a = src[i*stride]*7 + bias;
     int ind,t;
     
     // select index. this is a "linear scale" lerp factor between 0 (val=min) and 7 (val=max).
@@ -611,13 +612,14 @@ static void stb__InitDXT() {
   stb__PrepareOptTable(&stb__OMatch6[0][0],stb__Expand6,64);
 }
 
-static int init=1;
+// function local statics are initialized once even when called from several threads
+static void stb__EnsureInit() {
+  static bool initialized = (stb__InitDXT(), true);
+  (void)initialized;
+}
 
 void stb_compress_dxt1_block(unsigned char *dest, const unsigned char *src, bool alpha, int mode) {
-  if (init) {
-    stb__InitDXT();
-    init=0;
-  }
+  stb__EnsureInit();
   
   if (alpha) {
     stb__CompressAlphaBlock(dest,(unsigned char*) src,mode);
@@ -627,22 +629,18 @@ void stb_compress_dxt1_block(unsigned char *dest, const unsigned char *src, bool
   stb__CompressColorBlock(dest,(unsigned char*) src,mode);
 }
 
+// src is 16 single channel values
 void stb_compress_rgtc1_block(unsigned char *dest, const unsigned char *src) {
-  if (init) {
-    stb__InitDXT();
-    init = 0;
-  } 
-  stb__CompressRGTCBlock(dest, (unsigned char*) src);
+  stb__EnsureInit();
+  stb__CompressRGTCBlock(dest, (unsigned char*) src, 1);
 }
 
+// src is 16 interleaved pairs of values
 void stb_compress_rgtc2_block(unsigned char *dest, const unsigned char *src) {
-  if (init) {
-    stb__InitDXT();
-    init=0;
-  }
+  stb__EnsureInit();
 
-  stb__CompressRGTCBlock(dest, (unsigned char*) src);
+  stb__CompressRGTCBlock(dest, (unsigned char*) src, 2);
   dest += 8;
-  stb__CompressRGTCBlock(dest, (unsigned char*) src + 256);
+  stb__CompressRGTCBlock(dest, (unsigned char*) src + 1, 2);
   dest += 8;   
 }